@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+typedef char symbol;
+
+/// Count the set bits in a 64bit value
+inline int popCount64(uint64_t value) {
+#if defined(_MSC_VER) && defined(_M_X64)
+	return int(__popcnt64(value));
+#elif defined(_MSC_VER)
+	return int(__popcnt(unsigned(value)) + __popcnt(unsigned(value >> 32)));
+#else
+	return __builtin_popcountll(value);
+#endif
+}
+
+/// Get the index of the lowest set bit
+/// @param value - must not be 0
+inline int countTrailingZeros64(uint64_t value) {
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	_BitScanForward64(&index, value);
+	return int(index);
+#elif defined(_MSC_VER)
+	unsigned long index;
+	if (_BitScanForward(&index, unsigned(value))) {
+		return int(index);
+	}
+	_BitScanForward(&index, unsigned(value >> 32));
+	return int(index) + 32;
+#else
+	return __builtin_ctzll(value);
+#endif
+}
+
+/// Dense mapping between the bytes of an alphabet and their rank [0, size)
+struct RankTable {
+	/// The rank of each byte, -1 if the byte is not part of the alphabet
+	short ranks[256];
+	/// The symbol for each rank
+	symbol symbols[256];
+};
+
+/// Build the rank table of an alphabet policy, evaluated at compile time
+template <typename Alphabet>
+constexpr RankTable makeRankTable() {
+	RankTable table{};
+	for (int c = 0; c < 256; c++) {
+		table.ranks[c] = -1;
+	}
+	for (int r = 0; r < Alphabet::size; r++) {
+		table.symbols[r] = Alphabet::unrank(r);
+		table.ranks[static_cast<unsigned char>(Alphabet::unrank(r))] = short(r);
+	}
+	return table;
+}
+
+/// Alphabet policies used to specialize BasicAutomata
+/// Each policy has:
+///   size - the number of symbols in the alphabet
+///   unrank(rank) - the symbol for a given rank, must be increasing in unsigned byte order
+///                  so that iterating ranks gives lexicographic order of the words
+
+/// Every byte is a symbol, the generic alphabet
+struct ByteAlphabet {
+	static constexpr int size = 256;
+	static constexpr symbol unrank(int rank) {
+		return symbol(rank);
+	}
+};
+
+/// Only the lowercase latin letters a-z
+struct LowercaseAlphabet {
+	static constexpr int size = 26;
+	static constexpr symbol unrank(int rank) {
+		return symbol('a' + rank);
+	}
+};
+
+/// Only the decimal digits, useful for SKU codes
+struct DigitAlphabet {
+	static constexpr int size = 10;
+	static constexpr symbol unrank(int rank) {
+		return symbol('0' + rank);
+	}
+};
+
+/// The 4 letter nucleotide codes
+struct DnaAlphabet {
+	static constexpr int size = 4;
+	static constexpr symbol unrank(int rank) {
+		return "ACGT"[rank];
+	}
+};
+
+/// Compile time rank lookups for an alphabet policy
+template <typename Alphabet>
+struct AlphabetRanks {
+	static constexpr RankTable table = makeRankTable<Alphabet>();
+
+	/// Alphabets with up to 64 symbols can store transitions in a single 64bit bitmap
+	static constexpr bool isSmall = Alphabet::size <= 64;
+
+	/// Get the rank of a symbol
+	/// @return the rank or -1 if the symbol is not part of the alphabet
+	static int rankOf(symbol value) {
+		return table.ranks[static_cast<unsigned char>(value)];
+	}
+
+	/// Get the symbol for a rank, no bounds checking is performed
+	static symbol symbolOf(int rank) {
+		return table.symbols[rank];
+	}
+
+	/// Check if all symbols of a word are part of the alphabet
+	static bool isRepresentable(const char *word, int size) {
+		if (Alphabet::size == 256) {
+			return true;
+		}
+		for (int c = 0; c < size; c++) {
+			if (rankOf(word[c]) < 0) {
+				return false;
+			}
+		}
+		return true;
+	}
+};
+
+template <typename Alphabet>
+constexpr RankTable AlphabetRanks<Alphabet>::table;
@@ -1,6 +1,23 @@
 #include "Automata.h"
 
+#include <chrono>
+#include <cstring>
 #include <stack>
+#include <thread>
+
+#if AC_SIMD_TRANSITIONS && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define AC_SSE2 1
+#include <emmintrin.h>
+#else
+#define AC_SSE2 0
+#endif
+
+#if AC_SSE2 && defined(__AVX2__)
+#define AC_AVX2 1
+#include <immintrin.h>
+#else
+#define AC_AVX2 0
+#endif
 
 namespace
 {
@@ -31,42 +48,191 @@ inline size_t hash(const char *data, int size) {
 	return hash;
 }
 
-/// Check if a string is a prefix of another
-/// @param prefix - the needled
-/// @param string - the haystack
-/// @return true if string begins with prefix
-bool isPrefix(const std::string &prefix, const std::string &string) {
-	if (prefix.size() > string.size()) {
-		return false;
+/// States with up to this many transitions are searched linearly
+const int LINEAR_SHAPE_MAX_EDGES = 4;
+
+/// A single non final state with one edge gains nothing from the chain shortcut
+const uint32_t CHAIN_SHAPE_MIN_LENGTH = 2;
+
+/// Buckets of the registry with more states are counted together in HashStats::bucketLoads
+const int MAX_BUCKET_LOAD_REPORTED = 8;
+
+/// Number of suffixes a thread of getSuffixesParallel takes at once
+const uint32_t PARALLEL_SLICE_SUFFIXES = 4096;
+
+/// Glob pattern compiled to a bit parallel NFA
+/// Bit i of a set of positions means that the first i elements of the pattern are matched
+struct GlobPattern {
+	/// The last bit is the position after all elements
+	static const int MAX_ELEMENTS = 63;
+
+	/// The elements that accept each symbol
+	uint64_t symbolMasks[256];
+	/// The * elements, they stay on the same position when they accept a symbol
+	uint64_t stars = 0;
+	/// The number of elements
+	int count = 0;
+
+	/// Parse a pattern, see BasicAutomata::match for the syntax
+	/// @return false if the pattern is not valid or too long
+	bool compile(const std::string &pattern) {
+		std::fill(std::begin(symbolMasks), std::end(symbolMasks), 0);
+		stars = 0;
+		count = 0;
+
+		const size_t size = pattern.size();
+		for (size_t c = 0; c < size; c++) {
+			const unsigned char value = static_cast<unsigned char>(pattern[c]);
+			const uint64_t bit = uint64_t(1) << count;
+			if (value == '*' && count > 0 && (stars & (bit >> 1))) {
+				continue;
+			}
+			if (count == MAX_ELEMENTS) {
+				return false;
+			}
+
+			if (value == '*' || value == '?') {
+				stars |= value == '*' ? bit : 0;
+				for (uint64_t &mask : symbolMasks) {
+					mask |= bit;
+				}
+			} else if (value == '[') {
+				size_t end = c + 1;
+				const bool negate = end < size && (pattern[end] == '!' || pattern[end] == '^');
+				end += negate;
+				// ] right after the opening is part of the class
+				const size_t first = end;
+				bool inClass[256] = {};
+				for (; end < size && (pattern[end] != ']' || end == first); end++) {
+					const unsigned char from = static_cast<unsigned char>(pattern[end]);
+					unsigned char to = from;
+					if (end + 2 < size && pattern[end + 1] == '-' && pattern[end + 2] != ']') {
+						to = static_cast<unsigned char>(pattern[end + 2]);
+						end += 2;
+					}
+					for (int code = from; code <= to; code++) {
+						inClass[code] = true;
+					}
+				}
+				if (end >= size) {
+					return false;
+				}
+				for (int code = 0; code < 256; code++) {
+					symbolMasks[code] |= inClass[code] != negate ? bit : 0;
+				}
+				c = end;
+			} else {
+				const bool escaped = value == '\\' && c + 1 < size;
+				symbolMasks[static_cast<unsigned char>(escaped ? pattern[++c] : value)] |= bit;
+			}
+			++count;
+		}
+		return true;
 	}
-	for (int c = 0; c < prefix.size(); c++) {
-		if (string[c] != prefix[c]) {
-			return false;
+
+	/// The positions before any symbol
+	uint64_t start() const {
+		return closure(1);
+	}
+
+	/// Take a symbol from all positions
+	/// @return the new positions, 0 if nothing can match anymore
+	uint64_t step(uint64_t positions, symbol transition) const {
+		const uint64_t accepted = positions & symbolMasks[static_cast<unsigned char>(transition)];
+		return closure(((accepted & ~stars) << 1) | (accepted & stars));
+	}
+
+	/// Check if the whole pattern is matched
+	bool accepts(uint64_t positions) const {
+		return (positions >> count) & 1;
+	}
+
+	/// Add the positions after each *, as it also matches no symbols
+	uint64_t closure(uint64_t positions) const {
+		uint64_t next = positions | ((positions & stars) << 1);
+		while (next != positions) {
+			positions = next;
+			next = positions | ((positions & stars) << 1);
 		}
+		return positions;
 	}
-	return true;
+};
+
+/// Mask with the lowest @count bits set
+/// @param count - in [0, 63]
+inline uint64_t lowBits(int count) {
+	return (uint64_t(1) << count) - 1;
 }
 
 }
 
-Automata::Automata() {
+void SuffixChunkPool::clear() {
+	blocks.clear();
+	freeChunks = nullptr;
+	used = BLOCK_CHUNKS;
+}
+
+void SuffixChunkPool::addBlock() {
+	blocks.emplace_back(new Chunk[BLOCK_CHUNKS]);
+	used = 0;
+}
+
+template <typename Alphabet>
+BasicAutomata<Alphabet>::BasicAutomata() {
 	initEmpty();
 }
 
-void Automata::initEmpty() {
+template <typename Alphabet>
+void BasicAutomata<Alphabet>::initEmpty() {
+	resetBuildStates();
+	infixAutomata.reset();
+	infixOwnersStart.clear();
+	infixOwners.clear();
+	registry.clear();
+	words.clear();
+	totalSymbols = 0;
+	skippedWords = 0;
+	freeze();
+	releaseBuildStates();
+	clearCache();
+}
+
+template <typename Alphabet>
+void BasicAutomata<Alphabet>::resetBuildStates() {
 	allStates.resize(1);
 	allStates.front() = State();
 	rootState = &allStates.front();
+	freeStates = std::queue<State *>();
+	suffixPool.clear();
 	registry.clear();
-	words.clear();
-	totalSymbols = 0;
 }
 
-void Automata::build() {
+template <typename Alphabet>
+void BasicAutomata<Alphabet>::releaseBuildStates() {
+	registry.clear();
+	freeStates = std::queue<State *>();
+	allStates.clear();
+	suffixPool.clear();
+	equalSuffixes[0] = WordList();
+	equalSuffixes[1] = WordList();
+	rootState = nullptr;
+}
+
+template <typename Alphabet>
+void BasicAutomata<Alphabet>::build() {
 	std::sort(words.begin(), words.end());
-	const WordList::iterator it = std::unique(words.begin(), words.end());
+	const typename WordList::iterator it = std::unique(words.begin(), words.end());
 	words.erase(it, words.end());
 
+	const typename WordList::iterator representable = std::remove_if(words.begin(), words.end(), [](const std::string &word) {
+		return !Ranks::isRepresentable(word.data(), int(word.size()));
+	});
+	skippedWords = int(words.end() - representable);
+	words.erase(representable, words.end());
+
+	resetBuildStates();
+	totalSymbols = 0;
+	hashStats = HashStats();
 	State *start = nullptr;
 	int steps = 0;
 	for (int c = 0; c < words.size(); c++) {
@@ -93,104 +259,993 @@ void Automata::build() {
 		}
 	}
 
-	if (start && steps < words.back().size()) {
-		minimize(start, words.size() - 1, steps);
+	// the whole path of the last word is not registered yet, not only the part after its common prefix with the previous one
+	if (start) {
+		minimize(rootState, int(words.size()) - 1, 0);
 	}
 
-	registry.clear();
+	if (hashDiagnostics) {
+		collectRegistryStats();
+	}
+	freeze();
+	releaseBuildStates();
+	clearCache();
+	prefillCache();
+
+	if (infixIndexEnabled) {
+		buildInfixIndex();
+	}
+}
+
+template <typename Alphabet>
+bool BasicAutomata<Alphabet>::registryEqual(const State &a, const State &b) {
+	++hashStats.comparisons;
+	if (&a != &b && a.getHash(*this) != b.getHash(*this)) {
+		return false;
+	}
+
+	bool equal = false;
+	if (hashDiagnostics) {
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		equal = a.slowEqual(*this, b);
+		hashStats.slowEqualTime += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	} else {
+		equal = a.slowEqual(*this, b);
+	}
+	++(equal ? hashStats.truePositives : hashStats.falsePositives);
+	return equal;
+}
+
+template <typename Alphabet>
+void BasicAutomata<Alphabet>::collectRegistryStats() {
+	hashStats.registrySize = registry.size();
+	hashStats.buckets = registry.bucket_count();
+	hashStats.bucketLoads.assign(MAX_BUCKET_LOAD_REPORTED + 1, 0);
+	hashStats.maxBucketLoad = 0;
+	for (size_t c = 0; c < registry.bucket_count(); c++) {
+		const size_t load = registry.bucket_size(c);
+		++hashStats.bucketLoads[std::min(load, size_t(MAX_BUCKET_LOAD_REPORTED))];
+		hashStats.maxBucketLoad = std::max(hashStats.maxBucketLoad, load);
+	}
+
+	std::vector<size_t> hashes;
+	hashes.reserve(registry.size());
+	for (const StatePtr &ptr : registry) {
+		hashes.push_back(ptr.state->getHash(*this));
+	}
+	std::sort(hashes.begin(), hashes.end());
+	hashStats.sharedHashes = 0;
+	for (size_t c = 0; c < hashes.size(); c++) {
+		const bool same = (c > 0 && hashes[c - 1] == hashes[c]) || (c + 1 < hashes.size() && hashes[c + 1] == hashes[c]);
+		hashStats.sharedHashes += same;
+	}
+}
+
+template <typename Alphabet>
+void BasicAutomata<Alphabet>::buildInfixIndex() {
+	// all non empty suffixes as (word, offset), sorted by the suffix text
+	std::vector<std::pair<uint32_t, uint32_t>> all;
+	for (uint32_t c = 0; c < words.size(); c++) {
+		for (uint32_t r = 0; r < words[c].size(); r++) {
+			all.emplace_back(c, r);
+		}
+	}
+	std::sort(all.begin(), all.end(), [this](const std::pair<uint32_t, uint32_t> &a, const std::pair<uint32_t, uint32_t> &b) {
+		return strcmp(words[a.first].c_str() + a.second, words[b.first].c_str() + b.second) < 0;
+	});
+
+	// a word has each suffix only once so owners of a suffix never repeat
+	WordList suffixes;
+	infixOwnersStart.clear();
+	infixOwners.clear();
+	for (const std::pair<uint32_t, uint32_t> &item : all) {
+		const char *suffix = words[item.first].c_str() + item.second;
+		if (suffixes.empty() || strcmp(suffixes.back().c_str(), suffix)) {
+			infixOwnersStart.push_back(uint32_t(infixOwners.size()));
+			suffixes.emplace_back(suffix);
+		}
+		infixOwners.push_back(item.first);
+	}
+	infixOwnersStart.push_back(uint32_t(infixOwners.size()));
+	all.clear();
+	all.shrink_to_fit();
+
+	// suffixes are already sorted and unique, so their indices will not change when building
+	infixAutomata.reset(new BasicAutomata);
+	infixAutomata->buildFromWordList(std::move(suffixes));
+	ac_assert(infixAutomata->getNumberOfWords() + 1 == int(infixOwnersStart.size()));
+}
+
+template <typename Alphabet>
+void BasicAutomata<Alphabet>::freeze() {
+	frozenStates.clear();
+	suffixRanges.clear();
+	edgeLabels.clear();
+	edgeTargets.clear();
+	edgeBitmaps.clear();
+	frozenSuffixes.clear();
+
+	// Number the states in depth first order so that states on the path of a word are close in memory
+	std::vector<const State *> order;
+	std::vector<const State *> stack(1, rootState);
+	std::vector<const State *> children;
+	while (!stack.empty()) {
+		const State *state = stack.back();
+		stack.pop_back();
+		if (state->getFrozenId() != NO_STATE) {
+			continue;
+		}
+		state->setFrozenId(StateId(order.size()));
+		order.push_back(state);
+
+		children.clear();
+		state->getConnections().forEach([&children](int, const State *child) {
+			children.push_back(child);
+		});
+		// reversed so that the smallest rank is numbered first
+		stack.insert(stack.end(), children.rbegin(), children.rend());
+	}
+
+	frozenStates.resize(order.size());
+	suffixRanges.resize(order.size());
+	size_t numSuffixes = 0;
+	for (const State *state : order) {
+		numSuffixes += state->getSuffixList().size();
+	}
+	frozenSuffixes.reserve(numSuffixes);
+	for (StateId id = 0; id < order.size(); id++) {
+		const State &state = *order[id];
+		FrozenState &frozen = frozenStates[id];
+		frozen.firstEdge = uint32_t(edgeTargets.size());
+		frozen.numEdges = uint16_t(state.getNumChildren());
+		frozen.isFinal = state.isFinalState();
+
+		if (frozen.numEdges <= LINEAR_SHAPE_MAX_EDGES) {
+			frozen.shape = SHAPE_LINEAR;
+		} else if (AC_SSE2 && frozen.numEdges <= 16) {
+			frozen.shape = SHAPE_SIMD16;
+		} else if (AC_SSE2 && frozen.numEdges <= 32) {
+			frozen.shape = SHAPE_SIMD32;
+		} else {
+			// too wide for a single SIMD compare, bitmap lookup does not depend on the number of transitions
+			frozen.shape = SHAPE_BITMAP;
+			frozen.bitmap = uint32_t(edgeBitmaps.size() / BITMAP_WORDS);
+			edgeBitmaps.resize(edgeBitmaps.size() + BITMAP_WORDS, 0);
+		}
+
+		uint64_t *bitmap = frozen.shape == SHAPE_BITMAP ? &edgeBitmaps[frozen.bitmap * BITMAP_WORDS] : nullptr;
+		state.getConnections().forEach([this, bitmap](int rank, const State *child) {
+			edgeLabels.push_back(Ranks::symbolOf(rank));
+			edgeTargets.push_back(child->getFrozenId());
+			if (bitmap) {
+				bitmap[rank >> 6] |= uint64_t(1) << (rank & 63);
+			}
+		});
+
+		const SuffixChunkList &suffixes = state.getSuffixList();
+		suffixRanges[id].first = uint32_t(frozenSuffixes.size());
+		suffixRanges[id].count = uint32_t(suffixes.size());
+		suffixes.forEach([this](int wordIndex, int offset) {
+			frozenSuffixes.emplace_back(wordIndex, offset);
+		});
+	}
+	edgeLabels.resize(edgeLabels.size() + LABEL_PADDING, 0);
+
+	if (pathCompression) {
+		compressChains();
+	}
+	placeFrozenArrays();
+}
+
+template <typename Alphabet>
+void BasicAutomata<Alphabet>::setHugePages(bool enabled) {
+	hugePages = enabled;
+	placeFrozenArrays();
+}
+
+template <typename Alphabet>
+void BasicAutomata<Alphabet>::placeFrozenArrays() {
+	const auto place = [this](auto &array) {
+		typedef typename std::decay<decltype(array)>::type Array;
+		if (array.get_allocator().enabled == hugePages) {
+			return;
+		}
+		Array placed{typename Array::allocator_type(hugePages)};
+		placed.reserve(array.size());
+		placed.assign(array.begin(), array.end());
+		array = std::move(placed);
+	};
+	place(frozenStates);
+	place(suffixRanges);
+	place(edgeLabels);
+	place(edgeTargets);
+	place(edgeBitmaps);
+	place(frozenSuffixes);
+}
+
+template <typename Alphabet>
+size_t BasicAutomata<Alphabet>::getHugePageBytes() const {
+	size_t bytes = 0;
+	const auto add = [&bytes](const auto &array) {
+		const size_t size = array.capacity() * sizeof(array[0]);
+		bytes += array.get_allocator().usesHugePages(size) ? size : 0;
+	};
+	add(frozenStates);
+	add(suffixRanges);
+	add(edgeLabels);
+	add(edgeTargets);
+	add(edgeBitmaps);
+	add(frozenSuffixes);
+	return bytes;
 }
 
-const std::string &Automata::getWord(int index) const {
+template <typename Alphabet>
+void BasicAutomata<Alphabet>::compressChains() {
+	const auto isChain = [this](StateId id) {
+		return frozenStates[id].numEdges == 1 && !frozenStates[id].isFinal;
+	};
+
+	// Depth first numbering gives consecutive ids to a chain unless it joins an already numbered state
+	// Each state has a single edge, so the labels of consecutive states are also consecutive in edgeLabels
+	for (StateId id = StateId(frozenStates.size()); id-- > 0; ) {
+		if (!isChain(id)) {
+			continue;
+		}
+		FrozenState &frozen = frozenStates[id];
+		const StateId next = edgeTargets[frozen.firstEdge];
+		const bool continues = next == id + 1 && isChain(next);
+		frozen.chainLength = continues ? frozenStates[next].chainLength + 1 : 1;
+		frozen.shape = frozen.chainLength >= CHAIN_SHAPE_MIN_LENGTH ? SHAPE_CHAIN : SHAPE_LINEAR;
+	}
+}
+
+template <typename Alphabet>
+int BasicAutomata<Alphabet>::getNumberOfChainStates() const {
+	int count = 0;
+	// the root is not counted as nothing leads to it
+	for (StateId id = 1; id < frozenStates.size(); id++) {
+		count += frozenStates[id].numEdges == 1 && !frozenStates[id].isFinal;
+	}
+	return count;
+}
+
+template <typename Alphabet>
+size_t BasicAutomata<Alphabet>::getMemoryUsage() const {
+	size_t bytes = frozenStates.capacity() * sizeof(FrozenState) +
+		suffixRanges.capacity() * sizeof(SuffixRange) +
+		edgeLabels.capacity() * sizeof(symbol) +
+		edgeTargets.capacity() * sizeof(StateId) +
+		edgeBitmaps.capacity() * sizeof(uint64_t) +
+		frozenSuffixes.capacity() * sizeof(typename State::Suffix) +
+		words.capacity() * sizeof(std::string) +
+		(infixOwnersStart.capacity() + infixOwners.capacity()) * sizeof(uint32_t);
+
+	for (const std::string &word : words) {
+		bytes += word.capacity() >= sizeof(std::string) ? word.capacity() + 1 : 0;
+	}
+	if (infixAutomata) {
+		bytes += infixAutomata->getMemoryUsage();
+	}
+	return bytes;
+}
+
+template <typename Alphabet>
+int BasicAutomata<Alphabet>::getNumberOfStatesWithShape(TransitionShape shape) const {
+	int count = 0;
+	for (const FrozenState &state : frozenStates) {
+		count += state.shape == shape;
+	}
+	return count;
+}
+
+template <typename Alphabet>
+const std::string &BasicAutomata<Alphabet>::getWord(int index) const {
 	return words[index];
 }
 
-bool Automata::getSuffixes(const std::string &prefix, WordList &suffixes) const {
-	const State *start = findState(prefix);
-	if (!start) {
+template <typename Alphabet>
+bool BasicAutomata<Alphabet>::getSuffixes(const std::string &prefix, WordList &suffixes) const {
+	return getSuffixes(prefix, suffixes, INT_MAX);
+}
+
+template <typename Alphabet>
+bool BasicAutomata<Alphabet>::getSuffixes(const std::string &prefix, WordList &suffixes, int limit) const {
+	const StateId start = findState(prefix);
+	if (start == NO_STATE) {
+		return false;
+	}
+	if (limit <= 0) {
+		return true;
+	}
+
+	if (cacheSettings.completions > 0) {
+		{
+			std::shared_lock<std::shared_timed_mutex> lock(cacheMutex);
+			if (getCachedSuffixes(start, suffixes, limit)) {
+				++cacheHits;
+				return true;
+			}
+		}
+		++cacheMisses;
+
+		// a state is added on its second miss, most long prefixes are queried once and would only fill the cache
+		const uint64_t seenBit = uint64_t(1) << (start & 63);
+		if (cacheSettings.adaptive && cacheBytes < cacheSettings.maxBytes && (cacheSeen[start >> 6].fetch_or(seenBit) & seenBit)) {
+			std::unique_lock<std::shared_timed_mutex> lock(cacheMutex);
+			addToCache(start);
+			if (getCachedSuffixes(start, suffixes, limit)) {
+				return true;
+			}
+		}
+	}
+
+	appendSuffixes(start, suffixes, limit);
+	return true;
+}
+
+template <typename Alphabet>
+bool BasicAutomata<Alphabet>::getSuffixes(const std::string &prefix, WordList &suffixes, int limit, const std::string &after) const {
+	const StateId start = findState(prefix);
+	if (start == NO_STATE) {
+		return false;
+	}
+	// the cache only has the first suffixes of a state, pages after it are read from the suffix range
+	StateId end = NO_STATE;
+	const uint32_t smaller = countSmaller(start, after, end);
+	appendSuffixes(start, suffixes, limit, smaller + (end != NO_STATE && frozenStates[end].isFinal));
+	return true;
+}
+
+template <typename Alphabet>
+int BasicAutomata<Alphabet>::countSuffixes(const std::string &prefix) const {
+	const StateId state = findState(prefix);
+	return state == NO_STATE ? 0 : int(getStateCount(state));
+}
+
+template <typename Alphabet>
+int BasicAutomata<Alphabet>::rank(const std::string &word) const {
+	StateId end = NO_STATE;
+	return int(countSmaller(0, word, end));
+}
+
+template <typename Alphabet>
+uint32_t BasicAutomata<Alphabet>::countSmaller(StateId state, const std::string &word, StateId &end) const {
+	uint32_t result = 0;
+	end = NO_STATE;
+	for (size_t c = 0; c < word.size(); c++) {
+		const FrozenState &frozen = frozenStates[state];
+		// the word ending here is a prefix of @word, so it is smaller
+		result += frozen.isFinal;
+
+		// labels are in rank order, which is also unsigned byte order
+		const unsigned char wanted = static_cast<unsigned char>(word[c]);
+		uint32_t edge = frozen.firstEdge;
+		const uint32_t lastEdge = frozen.firstEdge + frozen.numEdges;
+		while (edge < lastEdge && static_cast<unsigned char>(edgeLabels[edge]) < wanted) {
+			result += getStateCount(edgeTargets[edge]);
+			++edge;
+		}
+		if (edge == lastEdge || static_cast<unsigned char>(edgeLabels[edge]) != wanted) {
+			return result;
+		}
+		state = edgeTargets[edge];
+	}
+	end = state;
+	return result;
+}
+
+template <typename Alphabet>
+int BasicAutomata<Alphabet>::select(const std::string &prefix, int index) const {
+	int first = 0, count = 0;
+	if (!getWordRange(prefix, first, count) || index < 0 || index >= count) {
+		return -1;
+	}
+	return first + index;
+}
+
+template <typename Alphabet>
+bool BasicAutomata<Alphabet>::getWordRange(const std::string &prefix, int &first, int &count) const {
+	// a single walk finds the state of the prefix and counts the smaller words
+	StateId state = NO_STATE;
+	const uint32_t smaller = countSmaller(0, prefix, state);
+	if (state == NO_STATE) {
+		return false;
+	}
+	// the sorted word list can start with the empty word, which is not in the automata
+	const int firstWord = !words.empty() && words.front().empty() ? 1 : 0;
+	first = firstWord + int(smaller);
+	count = int(getStateCount(state));
+	return true;
+}
+
+template <typename Alphabet>
+bool BasicAutomata<Alphabet>::getSuffixesParallel(const std::string &prefix, WordList &suffixes, int threads) const {
+	const StateId start = findState(prefix);
+	if (start == NO_STATE) {
 		return false;
 	}
-	if (start->isFinalState()) {
+	if (frozenStates[start].isFinal) {
 		suffixes.push_back("");
 	}
-	start->buildSuffixes(*this, suffixes);
+
+	// the strings are created here, so the threads only fill them
+	const SuffixRange &range = suffixRanges[start];
+	const size_t first = suffixes.size();
+	suffixes.resize(first + range.count);
+
+	const uint32_t slices = (range.count + PARALLEL_SLICE_SUFFIXES - 1) / PARALLEL_SLICE_SUFFIXES;
+	if (threads <= 0) {
+		threads = std::max(1, int(std::thread::hardware_concurrency()));
+	}
+	threads = std::min(threads, int(slices));
+
+	std::atomic<uint32_t> nextSlice{0};
+	const auto fillSlices = [this, &range, &suffixes, first, slices, &nextSlice]() {
+		for (uint32_t slice = nextSlice++; slice < slices; slice = nextSlice++) {
+			const uint32_t begin = slice * PARALLEL_SLICE_SUFFIXES;
+			const uint32_t end = std::min(range.count, begin + PARALLEL_SLICE_SUFFIXES);
+			for (uint32_t c = begin; c < end; c++) {
+				const typename State::Suffix &suffix = frozenSuffixes[range.first + c];
+				suffixes[first + c].assign(words[suffix.wordIndex], suffix.offset, std::string::npos);
+			}
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (int c = 1; c < threads; c++) {
+		workers.emplace_back(fillSlices);
+	}
+	fillSlices();
+	for (std::thread &worker : workers) {
+		worker.join();
+	}
+	return true;
+}
+
+template <typename Alphabet>
+void BasicAutomata<Alphabet>::appendSuffixes(StateId state, WordList &suffixes, int limit, uint32_t skip) const {
+	if (limit <= 0) {
+		return;
+	}
+	if (frozenStates[state].isFinal) {
+		if (skip == 0) {
+			suffixes.push_back("");
+			--limit;
+		} else {
+			--skip;
+		}
+	}
+
+	// the range is sorted, so a page is a slice of it
+	const SuffixRange &range = suffixRanges[state];
+	if (skip >= range.count) {
+		return;
+	}
+	const uint32_t count = std::min(range.count - skip, uint32_t(limit));
+	int c = suffixes.size();
+	suffixes.resize(suffixes.size() + count);
+	for (uint32_t r = range.first + skip; r < range.first + skip + count; r++) {
+		const typename State::Suffix &suffix = frozenSuffixes[r];
+		suffixes[c++].assign(words[suffix.wordIndex], suffix.offset, std::string::npos);
+	}
+}
+
+template <typename Alphabet>
+void BasicAutomata<Alphabet>::setCacheSettings(const CacheSettings &settings) {
+	cacheSettings = settings;
+	clearCache();
+	prefillCache();
+}
+
+template <typename Alphabet>
+int BasicAutomata<Alphabet>::getNumberOfCachedStates() const {
+	std::shared_lock<std::shared_timed_mutex> lock(cacheMutex);
+	return int(cache.size());
+}
+
+template <typename Alphabet>
+void BasicAutomata<Alphabet>::clearCache() {
+	cache.clear();
+	cacheSeen = std::vector<std::atomic<uint64_t>>(cacheSettings.adaptive ? (frozenStates.size() + 63) / 64 : 0);
+	cacheBytes = 0;
+	cacheHits = 0;
+	cacheMisses = 0;
+}
+
+template <typename Alphabet>
+void BasicAutomata<Alphabet>::addToCache(StateId state) const {
+	if (cache.find(state) != cache.end()) {
+		return;
+	}
+
+	// rough estimate of the hash map node and the heap memory of the strings, from the suffix lengths so that
+	// entries that do not fit are not built
+	const bool isFinal = frozenStates[state].isFinal;
+	const SuffixRange &range = suffixRanges[state];
+	const uint32_t count = std::min(range.count, uint32_t(cacheSettings.completions - isFinal));
+	size_t bytes = sizeof(StateId) + sizeof(CacheEntry) + 2 * sizeof(void *) + (count + isFinal) * sizeof(std::string);
+	for (uint32_t r = range.first; r < range.first + count; r++) {
+		const size_t length = words[frozenSuffixes[r].wordIndex].size() - frozenSuffixes[r].offset;
+		bytes += length >= sizeof(std::string) ? length + 1 : 0;
+	}
+	if (cacheBytes + bytes > cacheSettings.maxBytes) {
+		return;
+	}
+
+	CacheEntry entry;
+	appendSuffixes(state, entry.suffixes, cacheSettings.completions);
+	entry.complete = getStateCount(state) <= uint32_t(cacheSettings.completions);
+	cacheBytes += bytes;
+	cache.emplace(state, std::move(entry));
+}
+
+template <typename Alphabet>
+bool BasicAutomata<Alphabet>::getCachedSuffixes(StateId state, WordList &suffixes, int limit) const {
+	const typename std::unordered_map<StateId, CacheEntry>::const_iterator it = cache.find(state);
+	if (it == cache.end()) {
+		return false;
+	}
+	const WordList &cached = it->second.suffixes;
+	if (!it->second.complete && size_t(limit) > cached.size()) {
+		return false;
+	}
+	suffixes.insert(suffixes.end(), cached.begin(), cached.begin() + std::min(cached.size(), size_t(limit)));
+	return true;
+}
+
+template <typename Alphabet>
+void BasicAutomata<Alphabet>::prefillCache() {
+	if (cacheSettings.completions <= 0) {
+		return;
+	}
+
+	// breadth first so that shorter prefixes, which are queried the most, are cached first
+	std::unordered_set<StateId> visited;
+	std::vector<StateId> level(1, 0), next;
+	for (int depth = 0; depth <= cacheSettings.prefillDepth && !level.empty(); depth++) {
+		next.clear();
+		for (const StateId state : level) {
+			if (!visited.insert(state).second) {
+				continue;
+			}
+			addToCache(state);
+			if (cacheBytes >= cacheSettings.maxBytes) {
+				return;
+			}
+			const FrozenState &frozen = frozenStates[state];
+			next.insert(next.end(), edgeTargets.begin() + frozen.firstEdge, edgeTargets.begin() + frozen.firstEdge + frozen.numEdges);
+		}
+		level.swap(next);
+	}
+}
+
+
+template <typename Alphabet>
+bool BasicAutomata<Alphabet>::match(const std::string &pattern, const MatchCallback &callback, int limit) const {
+	GlobPattern glob;
+	if (!glob.compile(pattern)) {
+		return false;
+	}
+
+	struct Frame {
+		StateId state;
+		uint32_t edge;
+		/// The positions in the pattern after the word up to this state
+		uint64_t positions;
+	};
+	std::vector<Frame> stack(1, Frame{0, 0, glob.start()});
+	std::string word;
+	int matched = 0;
+	if (limit > 0 && frozenStates[0].isFinal && glob.accepts(stack.back().positions)) {
+		callback(word);
+		++matched;
+	}
+
+	while (!stack.empty() && matched < limit) {
+		Frame &top = stack.back();
+		const FrozenState &frozen = frozenStates[top.state];
+		if (top.edge == frozen.numEdges) {
+			stack.pop_back();
+			if (!stack.empty()) {
+				word.pop_back();
+			}
+			continue;
+		}
+
+		const uint32_t edge = frozen.firstEdge + top.edge++;
+		const uint64_t positions = glob.step(top.positions, edgeLabels[edge]);
+		if (!positions) {
+			// no word after this transition can match
+			continue;
+		}
+		const StateId target = edgeTargets[edge];
+		word.push_back(edgeLabels[edge]);
+		if (frozenStates[target].isFinal && glob.accepts(positions)) {
+			callback(word);
+			++matched;
+		}
+		stack.push_back(Frame{target, 0, positions});
+	}
 	return true;
 }
 
+template <typename Alphabet>
+bool BasicAutomata<Alphabet>::getWordsContaining(const std::string &infix, WordList &matches, int limit) const {
+	if (!infixAutomata || limit <= 0) {
+		return false;
+	}
+	const StateId start = infixAutomata->findState(infix);
+	if (start == NO_STATE) {
+		return false;
+	}
 
-GraphDump *Automata::getDefaultGraphDump(const std::string &filePath) {
+	// the same word is reached once for each place it contains infix at
+	std::unordered_set<uint32_t> seen;
+	const size_t first = matches.size();
+	const auto addOwners = [this, &seen, &matches, first, limit](int suffixIndex) {
+		for (uint32_t c = infixOwnersStart[suffixIndex]; c < infixOwnersStart[suffixIndex + 1]; c++) {
+			if (matches.size() - first >= size_t(limit)) {
+				return;
+			}
+			if (seen.insert(infixOwners[c]).second) {
+				matches.push_back(words[infixOwners[c]]);
+			}
+		}
+	};
+
+	if (infixAutomata->frozenStates[start].isFinal) {
+		// the infix is a whole suffix and the suffix ranges contain only the longer ones
+		const WordList &suffixes = infixAutomata->words;
+		addOwners(int(std::lower_bound(suffixes.begin(), suffixes.end(), infix) - suffixes.begin()));
+	}
+
+	const SuffixRange &range = infixAutomata->suffixRanges[start];
+	for (uint32_t c = range.first; c < range.first + range.count && matches.size() - first < size_t(limit); c++) {
+		addOwners(infixAutomata->frozenSuffixes[c].wordIndex);
+	}
+	return matches.size() > first;
+}
+
+template <typename Alphabet>
+GraphDump *BasicAutomata<Alphabet>::getDefaultGraphDump(const std::string &filePath) {
 	if (!dotGraphViz.init(filePath)) {
 		return nullptr;
 	}
 	return &dotGraphViz;
 }
 
-bool Automata::dumpGraph(GraphDump *graphDump) const {
+template <typename Alphabet>
+GraphDump *BasicAutomata<Alphabet>::getBinaryGraphDump(const std::string &filePath) {
+	if (!binaryEdgeList.init(filePath)) {
+		return nullptr;
+	}
+	return &binaryEdgeList;
+}
+
+template <typename Alphabet>
+bool BasicAutomata<Alphabet>::dumpGraph(GraphDump *graphDump) const {
 	if (!graphDump) {
 		return false;
 	}
-	graphDump->start();
-	rootState->dumpGraph(*graphDump);
+	// the frozen states are numbered, so each state and edge is visited once in a single pass
+	graphDump->start(uint32_t(frozenStates.size()), uint32_t(edgeTargets.size()));
+	for (StateId id = 0; id < frozenStates.size(); id++) {
+		graphDump->addVertex(id, frozenStates[id].isFinal);
+	}
+	for (StateId id = 0; id < frozenStates.size(); id++) {
+		const FrozenState &frozen = frozenStates[id];
+		for (uint32_t c = frozen.firstEdge; c < frozen.firstEdge + frozen.numEdges; c++) {
+			graphDump->addEdge(id, edgeTargets[c], edgeLabels[c]);
+		}
+	}
 	graphDump->done();
+	return true;
 }
 
-bool Automata::verifyPrefix(int start, const std::string &prefix) const {
-#if AC_ASSERT_ENABLED
-	while (start > 0 && isPrefix(prefix, words[start - 1])) {
-		--start;
+template <typename Alphabet>
+bool BasicAutomata<Alphabet>::getCursor(const std::string &prefix, WordCursor &cursor) const {
+	const StateId state = findState(prefix);
+	if (state == NO_STATE) {
+		return false;
 	}
+	cursor.reset(*this, state);
+	return true;
+}
 
-	WordList suffixes;
-	(void)getSuffixes(prefix, suffixes);
-	std::sort(suffixes.begin(), suffixes.end());
+template <typename Alphabet>
+void BasicAutomata<Alphabet>::WordCursor::reset(const BasicAutomata &automata, StateId state) {
+	this->automata = &automata;
+	stack.assign(1, Frame{state, -1});
+	current.clear();
+}
 
-	for (const std::string &suffix : suffixes) {
-		if (prefix + suffix != words[start]) {
-			ac_assert(false);
+template <typename Alphabet>
+void BasicAutomata<Alphabet>::WordCursor::seek(const std::string &key) {
+	stack.resize(1);
+	stack[0].edge = -1;
+	current.clear();
+
+	for (size_t c = 0; c < key.size(); c++) {
+		const StateId state = stack.back().state;
+		const FrozenState &frozen = automata->frozenStates[state];
+		const symbol *labels = automata->edgeLabels.data() + frozen.firstEdge;
+		const unsigned char wanted = static_cast<unsigned char>(key[c]);
+
+		// labels are in rank order, which is also unsigned byte order
+		int edge = 0;
+		while (edge < frozen.numEdges && static_cast<unsigned char>(labels[edge]) < wanted) {
+			++edge;
+		}
+		if (edge == frozen.numEdges || static_cast<unsigned char>(labels[edge]) != wanted) {
+			// the word of this state and all transitions before edge are smaller than key
+			stack.back().edge = edge;
+			return;
+		}
+		stack.back().edge = edge + 1;
+		current.push_back(labels[edge]);
+		stack.push_back(Frame{automata->edgeTargets[frozen.firstEdge + edge], -1});
+	}
+}
+
+template <typename Alphabet>
+bool BasicAutomata<Alphabet>::WordCursor::next() {
+	while (!stack.empty()) {
+		Frame &top = stack.back();
+		const FrozenState &frozen = automata->frozenStates[top.state];
+		if (top.edge < 0) {
+			top.edge = 0;
+			if (frozen.isFinal) {
+				return true;
+			}
+		} else if (top.edge < frozen.numEdges) {
+			const uint32_t edge = frozen.firstEdge + top.edge++;
+			current.push_back(automata->edgeLabels[edge]);
+			stack.push_back(Frame{automata->edgeTargets[edge], -1});
+		} else {
+			stack.pop_back();
+			if (!stack.empty()) {
+				current.pop_back();
+			}
+		}
+	}
+	return false;
+}
+
+template <typename Alphabet>
+bool BasicAutomata<Alphabet>::verifyWordRange(int first, int last) const {
+	WordCursor cursor;
+	cursor.reset(*this, 0);
+	// the first range, after the empty word if there is one, does not seek so that words before words[first] are also found
+	if (first > 0 && !words[first - 1].empty()) {
+		cursor.seek(words[first]);
+	}
+
+	for (int c = first; c < last; c++) {
+		if (!cursor.next() || cursor.word() != words[c]) {
 			return false;
 		}
-		++start;
 	}
+	if (last < int(words.size())) {
+		return cursor.next() && cursor.word() == words[last];
+	}
+	return !cursor.next();
+}
 
-#endif
+template <typename Alphabet>
+bool BasicAutomata<Alphabet>::verifySuffixRanges(StateId first, StateId last) const {
+	WordCursor cursor;
+	for (StateId state = first; state < last; state++) {
+		cursor.reset(*this, state);
+		if (frozenStates[state].isFinal && (!cursor.next() || !cursor.word().empty())) {
+			return false;
+		}
+
+		// the ranges do not contain the empty suffix of final states
+		const SuffixRange &range = suffixRanges[state];
+		for (uint32_t c = range.first; c < range.first + range.count; c++) {
+			const typename State::Suffix &suffix = frozenSuffixes[c];
+			if (!cursor.next() || words[suffix.wordIndex].compare(suffix.offset, std::string::npos, cursor.word()) != 0) {
+				return false;
+			}
+		}
+		if (cursor.next()) {
+			return false;
+		}
+	}
 	return true;
 }
 
-bool Automata::runVerify() const {
-#if AC_ASSERT_ENABLED
-	std::unordered_set<size_t> ranTests;
-	const std::hash<std::string> hasher;
+template <typename Alphabet>
+bool BasicAutomata<Alphabet>::verifyAcyclicity() const {
+	// Kahn's algorithm, all states end up in the order only if there is no cycle
+	std::vector<uint32_t> inDegree(frozenStates.size(), 0);
+	for (const StateId target : edgeTargets) {
+		++inDegree[target];
+	}
+	if (inDegree[0] != 0) {
+		return false;
+	}
 
-	for (int r = 0; r < words.size(); r++) {
-		for (int c = 1; c < words[r].size(); c++) {
-			const std::string &prefix = words[r].substr(0, c);
-			const size_t hash = hasher(prefix);
-			if (!contains(ranTests, hash)) {
-				if (!verifyPrefix(r, prefix)) {
-					return false;
-				}
-				ranTests.insert(hash);
+	std::vector<StateId> order(1, 0);
+	order.reserve(frozenStates.size());
+	for (size_t c = 0; c < order.size(); c++) {
+		const FrozenState &frozen = frozenStates[order[c]];
+		for (uint32_t r = frozen.firstEdge; r < frozen.firstEdge + frozen.numEdges; r++) {
+			if (--inDegree[edgeTargets[r]] == 0) {
+				order.push_back(edgeTargets[r]);
 			}
 		}
 	}
+	return order.size() == frozenStates.size();
+}
 
-	std::unordered_set<const State *> visited;
-	rootState->verifyAcyclicity(visited);
-#endif
+template <typename Alphabet>
+bool BasicAutomata<Alphabet>::verifyMinimality() const {
+	// If there are no equal children, two states are equivalent only if they have the same final flag and transitions
+	// so it is enough to check for such pairs, no need to compare the languages
+	struct Signature {
+		const BasicAutomata *automata;
+		StateId state;
+
+		bool operator==(const Signature &other) const {
+			const FrozenState &a = automata->frozenStates[state];
+			const FrozenState &b = automata->frozenStates[other.state];
+			return a.isFinal == b.isFinal && a.numEdges == b.numEdges &&
+				std::equal(automata->edgeLabels.begin() + a.firstEdge, automata->edgeLabels.begin() + a.firstEdge + a.numEdges, automata->edgeLabels.begin() + b.firstEdge) &&
+				std::equal(automata->edgeTargets.begin() + a.firstEdge, automata->edgeTargets.begin() + a.firstEdge + a.numEdges, automata->edgeTargets.begin() + b.firstEdge);
+		}
+
+		struct Hasher {
+			size_t operator()(const Signature &signature) const {
+				const FrozenState &frozen = signature.automata->frozenStates[signature.state];
+				size_t result = ::hash(signature.automata->edgeLabels.data() + frozen.firstEdge, frozen.numEdges);
+				for (uint32_t c = frozen.firstEdge; c < frozen.firstEdge + frozen.numEdges; c++) {
+					result = hashCombine(result, size_t(signature.automata->edgeTargets[c]));
+				}
+				return hashCombine(result, size_t(frozen.isFinal));
+			}
+		};
+	};
+
+	std::unordered_set<Signature, typename Signature::Hasher> signatures(frozenStates.size());
+	for (StateId state = 0; state < frozenStates.size(); state++) {
+		const FrozenState &frozen = frozenStates[state];
+		// a state without transitions that is not final does not lead to any word, only allowed for empty automata
+		if (!frozen.isFinal && frozen.numEdges == 0 && state != 0) {
+			return false;
+		}
+		if (!signatures.insert(Signature{this, state}).second) {
+			return false;
+		}
+	}
 	return true;
 }
 
-const Automata::State *Automata::findState(const std::string &prefix) const {
-	const State *iterator = rootState;
-	int c = 0;
-	while (iterator && c < prefix.size()) {
-		iterator = iterator->findConnection(prefix[c]);
-		c++;
+template <typename Alphabet>
+bool BasicAutomata<Alphabet>::runVerify(int threads) const {
+	if (threads <= 0) {
+		threads = std::max(1, int(std::thread::hardware_concurrency()));
+	}
+
+	std::atomic<bool> valid{verifyAcyclicity() && verifyMinimality()};
+	ac_assert(valid && "Automata is not acyclic or not minimal");
+
+	// The empty word is never added to the automata in build
+	const int firstWord = !words.empty() && words.front().empty() ? 1 : 0;
+	const int numWords = int(words.size()) - firstWord;
+	const int numStates = int(frozenStates.size());
+	// do not start threads for a handful of words
+	threads = std::min(threads, std::max(1, numWords / 4096));
+
+	std::vector<std::thread> workers;
+	for (int c = 0; c < threads && valid; c++) {
+		workers.emplace_back([this, c, threads, firstWord, numWords, numStates, &valid]() {
+			const int first = firstWord + int(int64_t(numWords) * c / threads);
+			const int last = firstWord + int(int64_t(numWords) * (c + 1) / threads);
+			if (!verifyWordRange(first, last)) {
+				valid = false;
+				return;
+			}
+			const StateId firstState = StateId(int64_t(numStates) * c / threads);
+			const StateId lastState = StateId(int64_t(numStates) * (c + 1) / threads);
+			if (!verifySuffixRanges(firstState, lastState)) {
+				valid = false;
+			}
+		});
+	}
+	for (std::thread &worker : workers) {
+		worker.join();
+	}
+
+	ac_assert(valid && "Automata words do not match the word list");
+	return valid;
+}
+
+template <typename Alphabet>
+typename BasicAutomata<Alphabet>::StateId BasicAutomata<Alphabet>::findFrozenChild(StateId state, symbol transition) const {
+	const FrozenState &frozen = frozenStates[state];
+	const symbol *labels = edgeLabels.data() + frozen.firstEdge;
+
+	switch (frozen.shape) {
+#if AC_SSE2
+	case SHAPE_SIMD16: {
+		const __m128i needle = _mm_set1_epi8(transition);
+		const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(labels));
+		const uint64_t found = uint64_t(_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle))) & lowBits(frozen.numEdges);
+		return found ? edgeTargets[frozen.firstEdge + countTrailingZeros64(found)] : NO_STATE;
+	}
+	case SHAPE_SIMD32: {
+#if AC_AVX2
+		const __m256i needle = _mm256_set1_epi8(transition);
+		const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(labels));
+		const uint64_t found = uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle)))) & lowBits(frozen.numEdges);
+#else
+		const __m128i needle = _mm_set1_epi8(transition);
+		const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(labels));
+		const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(labels + 16));
+		const uint64_t found = (
+			uint64_t(_mm_movemask_epi8(_mm_cmpeq_epi8(low, needle))) |
+			uint64_t(_mm_movemask_epi8(_mm_cmpeq_epi8(high, needle))) << 16
+		) & lowBits(frozen.numEdges);
+#endif
+		return found ? edgeTargets[frozen.firstEdge + countTrailingZeros64(found)] : NO_STATE;
+	}
+#endif
+	case SHAPE_BITMAP: {
+		const int rank = Ranks::rankOf(transition);
+		if (rank < 0) {
+			return NO_STATE;
+		}
+		const uint64_t *bitmap = edgeBitmaps.data() + frozen.bitmap * BITMAP_WORDS;
+		const uint64_t bit = uint64_t(1) << (rank & 63);
+		const int word = rank >> 6;
+		if (!(bitmap[word] & bit)) {
+			return NO_STATE;
+		}
+		int index = popCount64(bitmap[word] & (bit - 1));
+		for (int c = 0; c < word; c++) {
+			index += popCount64(bitmap[c]);
+		}
+		return edgeTargets[frozen.firstEdge + index];
 	}
+	default:
+		for (int c = 0; c < frozen.numEdges; c++) {
+			if (labels[c] == transition) {
+				return edgeTargets[frozen.firstEdge + c];
+			}
+		}
+		return NO_STATE;
+	}
+}
 
-	return c < prefix.size() ? nullptr : iterator;
+template <typename Alphabet>
+typename BasicAutomata<Alphabet>::StateId BasicAutomata<Alphabet>::findState(const std::string &prefix) const {
+	const int size = int(prefix.size());
+	StateId state = 0;
+	for (int c = 0; c < size && state != NO_STATE; ) {
+		const FrozenState &frozen = frozenStates[state];
+		if (frozen.shape != SHAPE_CHAIN) {
+			state = findFrozenChild(state, prefix[c++]);
+			continue;
+		}
+
+		const int length = std::min(int(frozen.chainLength), size - c);
+		// chains are mostly a few symbols long, a plain loop is faster than calling memcmp
+		const symbol *labels = edgeLabels.data() + frozen.firstEdge;
+		for (int r = 0; r < length; r++) {
+			if (labels[r] != prefix[c + r]) {
+				return NO_STATE;
+			}
+		}
+		c += length;
+		// the prefix can end inside the chain, its states have consecutive ids
+		state = length == int(frozen.chainLength) ? edgeTargets[frozen.firstEdge + length - 1] : state + length;
+	}
+	return state;
 }
 
-Automata::State *Automata::addWordPrefix(int wordIndex, int &steps) {
+template <typename Alphabet>
+typename BasicAutomata<Alphabet>::State *BasicAutomata<Alphabet>::addWordPrefix(int wordIndex, int &steps) {
 	steps = 0;
 	
 	State *iterator = rootState;
@@ -198,7 +1253,7 @@ Automata::State *Automata::addWordPrefix(int wordIndex, int &steps) {
 	const symbol *wordIterator = words[wordIndex].c_str();
 
 	while (iterator && *wordIterator) {
-		iterator->appendSuffix(*this, wordIndex, steps);
+		iterator->appendSuffix(suffixPool, wordIndex, steps);
 		parent = iterator;
 		iterator = iterator->findConnection(*wordIterator);
 		++wordIterator;
@@ -209,7 +1264,8 @@ Automata::State *Automata::addWordPrefix(int wordIndex, int &steps) {
 	return parent;
 }
 
-void Automata::createNodes(State *start, int wordIndex, int offset) {
+template <typename Alphabet>
+void BasicAutomata<Alphabet>::createNodes(State *start, int wordIndex, int offset) {
 	const std::string &word = words[wordIndex];
 	for (int c = offset; c < word.size(); c++) {
 		State *newState = nullptr;
@@ -221,14 +1277,15 @@ void Automata::createNodes(State *start, int wordIndex, int offset) {
 			freeStates.pop();
 		}
 
-		newState->initSuffixesFrom(*this, *start, word[c]);
+		newState->initSuffixesFrom(*this, suffixPool, *start, word[c]);
 		start->addConnection(word[c], newState);
 		start = newState;
 	}
 	start->setIsFinalState();
 }
 
-bool Automata::isDetached(State *state) {
+template <typename Alphabet>
+bool BasicAutomata<Alphabet>::isDetached(State *state) {
 	for (State &iter : allStates) {
 		if (iter.hasChild(state)) {
 			return false;
@@ -237,7 +1294,8 @@ bool Automata::isDetached(State *state) {
 	return true;
 }
 
-void Automata::minimize(State *start, int wordIndex, int offset) {
+template <typename Alphabet>
+void BasicAutomata<Alphabet>::minimize(State *start, int wordIndex, int offset) {
 	ac_assert(start);
 	const symbol transition = words[wordIndex][offset];
 	State *lastChild = start->findConnection(transition);
@@ -250,7 +1308,7 @@ void Automata::minimize(State *start, int wordIndex, int offset) {
 	minimize(lastChild, wordIndex, offset + 1);
 
 	const StatePtr ptr{this, lastChild};
-	const Registry::iterator it = registry.find(ptr);
+	const typename Registry::iterator it = registry.find(ptr);
 	if (it != registry.end()) {
 		start->replaceChild(it->state, transition);
 		// Those two checks make building the Automata in debug very slow
@@ -258,7 +1316,7 @@ void Automata::minimize(State *start, int wordIndex, int offset) {
 		// ac_assert(isDetached(lastChild));
 		ac_assert(lastChild->isFinalState() == it->state->isFinalState());
 
-		lastChild->clear();
+		lastChild->clear(suffixPool);
 		freeStates.push(lastChild);
 	} else {
 		registry.insert(ptr);
@@ -269,65 +1327,70 @@ void Automata::minimize(State *start, int wordIndex, int offset) {
 /// Automata::state methods ///
 ///////////////////////////////
 
-Automata::State *Automata::State::findConnection(symbol transition) const {
-	const ConnectionMap::const_iterator it = connections.find(transition);
-	if (it == connections.end()) {
+template <typename Alphabet>
+typename BasicAutomata<Alphabet>::State *BasicAutomata<Alphabet>::State::findConnection(symbol transition) const {
+	const int rank = Ranks::rankOf(transition);
+	if (rank < 0) {
 		return nullptr;
 	}
 
-	return it->second;
+	return connections.find(rank);
 }
 
-void Automata::State::setIsFinalState() {
+template <typename Alphabet>
+void BasicAutomata<Alphabet>::State::setIsFinalState() {
 	isFinal = true;
 }
 
-bool Automata::State::isFinalState() const {
+template <typename Alphabet>
+bool BasicAutomata<Alphabet>::State::isFinalState() const {
 	return isFinal;
 }
 
-void Automata::State::addConnection(symbol transition, State *child) {
-	ac_assert(connections.find(transition) == connections.end() && "Already exists");
-	connections[transition] = child;
+template <typename Alphabet>
+void BasicAutomata<Alphabet>::State::addConnection(symbol transition, State *child) {
+	ac_assert(!connections.has(Ranks::rankOf(transition)) && "Already exists");
+	connections.insert(Ranks::rankOf(transition), child);
 	hashConnections = 42;
 }
 
-void Automata::State::appendSuffix(const Automata &automata, int wordIndex, int offset) {
-#if AC_ASSERT_ENABLED
-	const SuffixList::const_iterator it = std::find_if(suffixes.begin(), suffixes.end(), [wordIndex](const Suffix &suf) { return suf.wordIndex == wordIndex; });
-	ac_assert(it == suffixes.end() && "Can't duplicate suffixes");
-#endif
-	suffixes.emplace_back(wordIndex, offset);
+template <typename Alphabet>
+void BasicAutomata<Alphabet>::State::appendSuffix(SuffixChunkPool &pool, int wordIndex, int offset) {
+	// words are added in increasing index, so the list only has to check the last one for duplicates
+	suffixes.append(pool, wordIndex, offset);
 	hashSuffixes = 42;
 }
 
-void Automata::State::initSuffixesFrom(const Automata &automata, const State &parent, symbol transition) {
-	suffixes.clear();
-	for (const auto &item : parent.suffixes) {
-		const std::string &word = automata.getWord(item.wordIndex);
-		if (word[item.offset] == transition && item.offset + 1 < word.length()) {
-			suffixes.emplace_back(item.wordIndex, item.offset + 1);
+template <typename Alphabet>
+void BasicAutomata<Alphabet>::State::initSuffixesFrom(const BasicAutomata &automata, SuffixChunkPool &pool, const State &parent, symbol transition) {
+	suffixes.clear(pool);
+	parent.suffixes.forEach([this, &automata, &pool, transition](int wordIndex, int offset) {
+		const std::string &word = automata.getWord(wordIndex);
+		if (word[offset] == transition && size_t(offset) + 1 < word.length()) {
+			suffixes.append(pool, wordIndex, offset + 1);
 		}
-	}
+	});
 	hashSuffixes = 42;
 }
 
-void Automata::State::replaceChild(State *newChild, symbol transition) {
-	ac_assert(connections.find(transition) != connections.end());
-	connections[transition] = newChild;
+template <typename Alphabet>
+void BasicAutomata<Alphabet>::State::replaceChild(State *newChild, symbol transition) {
+	ac_assert(connections.has(Ranks::rankOf(transition)));
+	connections.replace(Ranks::rankOf(transition), newChild);
 	hashConnections = 42;
 }
 
-bool Automata::State::hasChild(const State *state) const {
-	for (auto &connection : connections) {
-		if (connection.second == state) {
-			return true;
-		}
-	}
-	return false;
+template <typename Alphabet>
+bool BasicAutomata<Alphabet>::State::hasChild(const State *state) const {
+	bool found = false;
+	connections.forEach([state, &found](int, const State *child) {
+		found = found || child == state;
+	});
+	return found;
 }
 
-size_t Automata::State::getHash(const Automata &automata) const {
+template <typename Alphabet>
+size_t BasicAutomata<Alphabet>::State::getHash(const BasicAutomata &automata) const {
 	if (hashConnections == 42) {
 		rebuildConnectionsHash();
 	}
@@ -337,27 +1400,31 @@ size_t Automata::State::getHash(const Automata &automata) const {
 	return hashCombine(hashConnections, hashCombine(size_t(isFinal), hashSuffixes));
 }
 
-int Automata::State::getNumChildren() const {
+template <typename Alphabet>
+int BasicAutomata<Alphabet>::State::getNumChildren() const {
 	return connections.size();
 }
 
-void Automata::State::buildSuffixes(const Automata &automata, WordList &stringSuffixes) const {
+template <typename Alphabet>
+void BasicAutomata<Alphabet>::State::buildSuffixes(const BasicAutomata &automata, WordList &stringSuffixes) const {
 	int c = stringSuffixes.size();
 	stringSuffixes.resize(stringSuffixes.size() + suffixes.size());
-	for (const auto &suffix : suffixes) {
-		const std::string &word = automata.getWord(suffix.wordIndex);
-		word.substr(suffix.offset).swap(stringSuffixes[c++]);
-	}
+	suffixes.forEach([&automata, &stringSuffixes, &c](int wordIndex, int offset) {
+		automata.getWord(wordIndex).substr(offset).swap(stringSuffixes[c++]);
+	});
 }
 
-void Automata::State::clear() {
+template <typename Alphabet>
+void BasicAutomata<Alphabet>::State::clear(SuffixChunkPool &pool) {
 	connections.clear();
-	suffixes.clear();
+	suffixes.clear(pool);
 	hashConnections = hashSuffixes = 42;
 	isFinal = false;
+	frozenId = NO_STATE;
 }
 
-bool Automata::State::slowEqual(const Automata &automata, const State &other) const {
+template <typename Alphabet>
+bool BasicAutomata<Alphabet>::State::slowEqual(const BasicAutomata &automata, const State &other) const {
 	if (this == &other) {
 		return true;
 	}
@@ -374,11 +1441,12 @@ bool Automata::State::slowEqual(const Automata &automata, const State &other) co
 		return false;
 	}
 
-	if (connections != other.connections) {
+	if (!(connections == other.connections)) {
 		return false;
 	}
 
-	static WordList mine, others;
+	WordList &mine = automata.equalSuffixes[0];
+	WordList &others = automata.equalSuffixes[1];
 	buildSuffixes(automata, mine);
 	other.buildSuffixes(automata, others);
 
@@ -392,85 +1460,61 @@ bool Automata::State::slowEqual(const Automata &automata, const State &other) co
 	return result;
 }
 
-std::string Automata::State::buildIdString() const {
-	char buff[128];
-	typedef unsigned long long llu;
-	snprintf(buff, sizeof(buff), "%llu | %llu | %d \\n", llu(hashConnections), llu(hashSuffixes), int(isFinal));
-	return buff;
-}
-
-void Automata::State::dumpGraph(GraphDump &graphDump) const {
-	const std::string mine = buildIdString();
-	for (const auto &child : connections) {
-
-		graphDump.addEdge(mine, child.second->buildIdString(), std::string(1, child.first));
-		child.second->dumpGraph(graphDump);
-	}
-}
-
-bool Automata::State::verifyAcyclicity(std::unordered_set<const State *> &visited) const {
-	visited.insert(this);
-	for (const auto &item : connections) {
-		if (contains<const State *>(visited, item.second)) {
-			ac_assert(false && "Cycle detected");
-			return false;
-		}
-		if (!item.second->verifyAcyclicity(visited)) {
-			return false;
-		}
-	}
-	visited.erase(visited.find(this));
-	return true;
-}
-
-void Automata::State::rebuildConnectionsHash() const {
+template <typename Alphabet>
+void BasicAutomata<Alphabet>::State::rebuildConnectionsHash() const {
 	hashConnections = 42;
-	const std::hash<symbol> symbolHasher;
+	const std::hash<int> rankHasher;
 
-	for (auto &item : connections) {
+	connections.forEach([this, &rankHasher](int rank, const State *child) {
 		hashConnections = hashCombine(
-			hashConnections, 
+			hashConnections,
 			hashCombine(
-				symbolHasher(item.first),
-				reinterpret_cast<uintptr_t>(item.second)
+				rankHasher(rank),
+				reinterpret_cast<uintptr_t>(child)
 			)
 		);
-	}
+	});
 }
 
-void Automata::State::rebuildSuffixesHash(const Automata &automata) const {
+template <typename Alphabet>
+void BasicAutomata<Alphabet>::State::rebuildSuffixesHash(const BasicAutomata &automata) const {
 	hashSuffixes = 42;
 
-#if HASH_STRATEGY == HASH_STRATEGY_SUM
-	for (const auto &suffix : suffixes) {
-		const std::string &word = automata.getWord(suffix.wordIndex);
-		for (int c = suffix.offset; c < word.size(); c++) {
-			hashSuffixes += word[c];
+	switch (automata.hashStrategy) {
+	case HASH_SUM:
+		suffixes.forEach([this, &automata](int wordIndex, int offset) {
+			const std::string &word = automata.getWord(wordIndex);
+			for (size_t c = offset; c < word.size(); c++) {
+				hashSuffixes += word[c];
+			}
+		});
+		break;
+	case HASH_XOR:
+		suffixes.forEach([this, &automata](int wordIndex, int offset) {
+			const std::string &word = automata.getWord(wordIndex);
+			hashSuffixes ^= hash(word.data() + offset, word.size() - offset);
+		});
+		break;
+	case HASH_SORT: {
+		// Suffixes might not be in sorted order, so to compute consistent hashes sort them first
+		std::vector<std::string> suffixSet;
+		suffixes.forEach([&automata, &suffixSet](int wordIndex, int offset) {
+			suffixSet.emplace_back(automata.getWord(wordIndex).substr(offset));
+		});
+		std::sort(suffixSet.begin(), suffixSet.end());
+
+		for (const std::string &suffix : suffixSet) {
+			hashSuffixes = hashCombine(
+				hashSuffixes,
+				std::hash<std::string>()(suffix)
+			);
 		}
+		break;
 	}
-#endif
-
-#if HASH_STRATEGY == HASH_STRATEGY_XOR
-	for (const auto &suffix : suffixes) {
-		const std::string &word = automata.getWord(suffix.wordIndex);
-		hashSuffixes ^= hash(word.data() + suffix.offset, word.size() - suffix.offset);
-	}
-#endif
-
-#if HASH_STRATEGY == HASH_STRATEGY_SORT
-	// Suffixes might not be in sorted order, so to compute consistent hashes sort them first
-	std::vector<std::string> suffixSet;
-	for (const auto &suffix : suffixes) {
-		const std::string &word = automata.getWord(suffix.wordIndex);
-		suffixSet.emplace_back(word.substr(suffix.offset));
 	}
-	std::sort(suffixSet.begin(), suffixSet.end());
-
-	for (const std::string &suffix : suffixSet) {
-		hashSuffixes = hashCombine(
-			hashSuffixes,
-			std::hash<std::string>()(suffix)
-		);
-	}
-#endif
 }
+
+template struct BasicAutomata<ByteAlphabet>;
+template struct BasicAutomata<LowercaseAlphabet>;
+template struct BasicAutomata<DigitAlphabet>;
+template struct BasicAutomata<DnaAlphabet>;
@@ -6,14 +6,22 @@
 #include <unordered_set>
 #include <map>
 #include <list>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <climits>
 #include <algorithm>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <queue>
 #include <set>
 #include <string>
+#include <vector>
 
-typedef char symbol;
+#include "Alphabet.h"
+#include "HugePages.h"
 
 #ifdef _DEBUG
 #define AC_ASSERT_ENABLED 1
@@ -27,8 +35,12 @@ typedef char symbol;
 #define HASH_STRATEGY_SUM 2
 #define HASH_STRATEGY_SORT 3
 
+/// The default for BasicAutomata::setHashStrategy
 #define HASH_STRATEGY HASH_STRATEGY_SUM
 
+/// Set to 0 to freeze all states with scalar transition search only
+#define AC_SIMD_TRANSITIONS 1
+
 /// Utility to check if a set contains an element
 template <typename T>
 inline bool contains(const std::unordered_set<T> &set, const T &value) {
@@ -37,30 +49,311 @@ inline bool contains(const std::unordered_set<T> &set, const T &value) {
 
 
 /// Interface used to dump the contents of the Automata's internal graph
-/// Edges are added explicitly and vertices are implicitly guessed from the edges, there are no unconnected vertices
+/// All vertices are added first in increasing id order, then all edges grouped by their start vertex
+/// Each vertex and each edge is added exactly once, so implementations can stream without remembering anything
 struct GraphDump {
-	/// Called before adding any edges of the graph
-	virtual void start() = 0;
-
-	/// Add an edge between two vertices, will be called multiple times for the same edge
-	/// @param from - label of the start vertex
-	/// @param to - label of the end vertex
-	/// @param label - the name of the edge (one symbol)
-	virtual void addEdge(const std::string &from, const std::string &to, const std::string &label) = 0;
+	/// Called before adding anything
+	/// @param numVertices - the number of vertices, their ids are in [0, numVertices), 0 is the start
+	/// @param numEdges - the number of edges that will be added
+	virtual void start(uint32_t numVertices, uint32_t numEdges) = 0;
+
+	/// Add a vertex
+	/// @param id - the id of the vertex
+	/// @param isFinal - true if some word ends in this vertex
+	virtual void addVertex(uint32_t id, bool isFinal) = 0;
+
+	/// Add an edge between two vertices
+	/// @param from - id of the start vertex
+	/// @param to - id of the end vertex
+	/// @param label - the symbol of the edge
+	virtual void addEdge(uint32_t from, uint32_t to, symbol label) = 0;
 
 	/// Called when all data is dumped
 	virtual void done() = 0;
 
-	~GraphDump() {}
+	virtual ~GraphDump() {}
+};
+
+/// Transitions of a single state while building the automata, keyed by the rank of the symbol in the alphabet
+/// The generic version used for big alphabets is an ordered map
+template <typename Alphabet, typename Child, bool IsSmall = AlphabetRanks<Alphabet>::isSmall>
+struct TransitionMap {
+	/// Find the child for a rank
+	/// @return the child or nullptr if there is no such transition
+	Child find(int rank) const {
+		const typename Map::const_iterator it = map.find(rank);
+		return it == map.end() ? nullptr : it->second;
+	}
+
+	/// Add new transition, the rank must not be already present
+	void insert(int rank, Child child) {
+		map[rank] = child;
+	}
+
+	/// Replace the child of an existing transition
+	void replace(int rank, Child child) {
+		map[rank] = child;
+	}
+
+	bool has(int rank) const {
+		return map.find(rank) != map.end();
+	}
+
+	int size() const {
+		return int(map.size());
+	}
+
+	void clear() {
+		map.clear();
+	}
+
+	bool operator==(const TransitionMap &other) const {
+		return map == other.map;
+	}
+
+	/// Call f(rank, child) for each transition in increasing rank order
+	template <typename F>
+	void forEach(F &&f) const {
+		for (const auto &item : map) {
+			f(item.first, item.second);
+		}
+	}
+
+private:
+	typedef std::map<int, Child> Map;
+	Map map;
+};
+
+/// Version for alphabets up to 64 symbols, bitmap of all present ranks and the children ordered by rank
+/// The index of a child is the number of bits set before its rank
+template <typename Alphabet, typename Child>
+struct TransitionMap<Alphabet, Child, true> {
+	Child find(int rank) const {
+		const uint64_t bit = uint64_t(1) << rank;
+		if (!(mask & bit)) {
+			return nullptr;
+		}
+		return children[popCount64(mask & (bit - 1))];
+	}
+
+	void insert(int rank, Child child) {
+		const uint64_t bit = uint64_t(1) << rank;
+		children.insert(children.begin() + popCount64(mask & (bit - 1)), child);
+		mask |= bit;
+	}
+
+	void replace(int rank, Child child) {
+		const uint64_t bit = uint64_t(1) << rank;
+		children[popCount64(mask & (bit - 1))] = child;
+	}
+
+	bool has(int rank) const {
+		return (mask >> rank) & 1;
+	}
+
+	int size() const {
+		return int(children.size());
+	}
+
+	void clear() {
+		mask = 0;
+		children.clear();
+	}
+
+	bool operator==(const TransitionMap &other) const {
+		return mask == other.mask && children == other.children;
+	}
+
+	template <typename F>
+	void forEach(F &&f) const {
+		uint64_t bits = mask;
+		for (int c = 0; bits; c++) {
+			f(countTrailingZeros64(bits), children[c]);
+			bits &= bits - 1;
+		}
+	}
+
+private:
+	uint64_t mask = 0;
+	std::vector<Child> children;
+};
+
+/// Bump allocator for the fixed size chunks of SuffixChunkList, only used while building
+/// Chunks are carved from big blocks, freed chunks are reused and all blocks are released at once
+struct SuffixChunkPool {
+	/// Bytes of suffix data in a chunk, the chunk also has the pointer to the next one
+	static const int CHUNK_BYTES = 24;
+
+	struct Chunk {
+		Chunk *next;
+		uint8_t bytes[CHUNK_BYTES];
+	};
+
+	Chunk *allocate() {
+		Chunk *chunk = freeChunks;
+		if (chunk) {
+			freeChunks = chunk->next;
+		} else {
+			if (used == BLOCK_CHUNKS) {
+				addBlock();
+			}
+			chunk = &blocks.back()[used++];
+		}
+		chunk->next = nullptr;
+		return chunk;
+	}
+
+	/// Return chunks linked from @first to @last for reuse
+	void release(Chunk *first, Chunk *last) {
+		last->next = freeChunks;
+		freeChunks = first;
+	}
+
+	/// Release all blocks, no chunk allocated before may be used after this
+	void clear();
+
+	/// Bytes of all blocks
+	size_t getMemoryUsage() const {
+		return blocks.size() * BLOCK_CHUNKS * sizeof(Chunk);
+	}
+
+private:
+	/// Number of chunks allocated at once
+	static const int BLOCK_CHUNKS = 4096;
+
+	std::vector<std::unique_ptr<Chunk[]>> blocks;
+	Chunk *freeChunks = nullptr;
+	/// Number of chunks used from the last block
+	int used = BLOCK_CHUNKS;
+
+	void addBlock();
+};
+
+/// The suffixes of a state while building, as (word index, offset) pairs with increasing word index
+/// All suffixes of a state start at the same offset, as a state is reached only by prefixes of the same length
+/// while it is built. The first word index is kept as it is, the rest as variable length deltas from the previous one
+/// in chunks from a SuffixChunkPool, so a state with a single suffix needs no chunk at all.
+struct SuffixChunkList {
+	/// Append a suffix, @wordIndex must be bigger than all word indices in the list
+	void append(SuffixChunkPool &pool, int wordIndex, int offset) {
+		ac_assert((count == 0 || (wordIndex > lastWord && offset == this->offset)) && "Can't duplicate suffixes or mix offsets");
+		if (count == 0) {
+			firstWord = lastWord = wordIndex;
+			this->offset = offset;
+			count = 1;
+			return;
+		}
+		uint32_t delta = uint32_t(wordIndex - lastWord);
+		while (delta >= 128) {
+			pushByte(pool, uint8_t(delta | 128));
+			delta >>= 7;
+		}
+		pushByte(pool, uint8_t(delta));
+		lastWord = wordIndex;
+		++count;
+	}
+
+	/// Remove all suffixes and give the chunks back to the pool
+	void clear(SuffixChunkPool &pool) {
+		if (head) {
+			pool.release(head, tail);
+		}
+		head = tail = nullptr;
+		tailUsed = SuffixChunkPool::CHUNK_BYTES;
+		count = 0;
+	}
+
+	int size() const {
+		return count;
+	}
+
+	/// Call f(wordIndex, offset) for each suffix in increasing word index order
+	template <typename F>
+	void forEach(F &&f) const {
+		if (count == 0) {
+			return;
+		}
+		int wordIndex = firstWord;
+		f(wordIndex, offset);
+
+		const SuffixChunkPool::Chunk *chunk = head;
+		int position = 0;
+		for (int c = 1; c < count; c++) {
+			uint32_t delta = 0;
+			int shift = 0;
+			uint8_t byte = 0;
+			do {
+				if (position == SuffixChunkPool::CHUNK_BYTES) {
+					chunk = chunk->next;
+					position = 0;
+				}
+				byte = chunk->bytes[position++];
+				delta |= uint32_t(byte & 127) << shift;
+				shift += 7;
+			} while (byte & 128);
+			wordIndex += int(delta);
+			f(wordIndex, offset);
+		}
+	}
+
+private:
+	SuffixChunkPool::Chunk *head = nullptr;
+	SuffixChunkPool::Chunk *tail = nullptr;
+	int count = 0;
+	int offset = -1;
+	int firstWord = -1;
+	int lastWord = -1;
+	/// Bytes used in tail
+	int tailUsed = SuffixChunkPool::CHUNK_BYTES;
+
+	void pushByte(SuffixChunkPool &pool, uint8_t byte) {
+		if (tailUsed == SuffixChunkPool::CHUNK_BYTES) {
+			SuffixChunkPool::Chunk *chunk = pool.allocate();
+			if (tail) {
+				tail->next = chunk;
+			} else {
+				head = chunk;
+			}
+			tail = chunk;
+			tailUsed = 0;
+		}
+		tail->bytes[tailUsed++] = byte;
+	}
 };
 
 /// The implementation of the automata recognizing the prefix/suffixes
-struct Automata {
+/// @param Alphabet - alphabet policy (see Alphabet.h), words with symbols outside of it are skipped when building
+/// NOTE: member definitions are in Automata.cpp and instantiated there for all policies in Alphabet.h
+template <typename Alphabet>
+struct BasicAutomata {
+	/// Compile time symbol <-> rank mapping for the alphabet
+	typedef AlphabetRanks<Alphabet> Ranks;
+
 	/// List of words, used to initialize the automata
 	typedef std::vector<std::string> WordList;
 
+	/// Index of a state in the frozen automata, the root is always 0
+	typedef uint32_t StateId;
+	static constexpr StateId NO_STATE = StateId(-1);
+
+	/// How the transitions of a frozen state are searched, chosen for each state when freezing
+	enum TransitionShape : uint8_t {
+		/// Compare each label, used for states with few transitions
+		SHAPE_LINEAR,
+		/// Single SIMD compare over 16 labels
+		SHAPE_SIMD16,
+		/// SIMD compare over 32 labels
+		SHAPE_SIMD32,
+		/// Bitmap over the ranks of the alphabet, child index is the popcount before the symbol's rank
+		SHAPE_BITMAP,
+		/// Single transition starting a chain of non final states with a single transition and consecutive ids
+		/// The labels of the chain are contiguous in edgeLabels and are compared at once
+		SHAPE_CHAIN,
+		SHAPE_COUNT
+	};
+
 	/// Initialize empty automata, ready to call buildFromWordList on
-	Automata();
+	BasicAutomata();
 
 	/// Clear all the memory associated with recognizing words
 	void clear() {
@@ -94,11 +387,139 @@ struct Automata {
 	/// @return false if the prefix is not recognized, false otherwise
 	bool getSuffixes(const std::string &prefix, WordList &suffixes) const;
 
+	/// Get up to some number of suffixes for a given prefix, served from the completion cache when possible
+	/// The suffixes are in lexicographic order, the empty suffix first, and only @limit of them are built
+	/// @param prefix - the prefix to search for
+	/// @param suffixes[out] - the first @limit suffixes for the prefix are appended
+	/// @param limit - the maximum number of suffixes to append
+	/// @return false if the prefix is not recognized, true otherwise
+	bool getSuffixes(const std::string &prefix, WordList &suffixes, int limit) const;
+
+	/// Get a page of the suffixes for a given prefix, the ones after the last suffix of the previous page
+	/// The position of @after is found by counting the words of the smaller transitions on its path like rank,
+	/// so the cost depends on the length of @after and the size of the page, not on the number of suffixes
+	/// @param prefix - the prefix to search for
+	/// @param suffixes[out] - up to @limit suffixes greater than @after are appended in lexicographic order
+	/// @param limit - the maximum number of suffixes to append
+	/// @param after - the suffixes up to and including this one are skipped, it does not have to be a suffix
+	/// @return false if the prefix is not recognized, true otherwise
+	bool getSuffixes(const std::string &prefix, WordList &suffixes, int limit, const std::string &after) const;
+
+	/// Get all suffixes for a given prefix with several threads, for prefixes with a very big number of suffixes
+	/// The suffix range of the prefix is split in slices of the same size, each thread takes the next free slice when
+	/// done with its own and writes it in place, so the suffixes are in the same order as from getSuffixes
+	/// @param prefix - the prefix to search for
+	/// @param suffixes[out] - all suffixes for the prefix are appended
+	/// @param threads - the number of threads including the calling one, 0 for the number of hardware threads
+	/// @return false if the prefix is not recognized, true otherwise
+	bool getSuffixesParallel(const std::string &prefix, WordList &suffixes, int threads = 0) const;
+
+	/// Settings for the completion cache, which keeps the first suffixes of hot states
+	struct CacheSettings {
+		/// Number of suffixes kept for each cached state, INT_MAX to keep all, 0 disables the cache
+		int completions = 0;
+		/// When building, cache all states reachable with a prefix up to this length
+		int prefillDepth = 0;
+		/// Cache states on their second miss, for hot sets that are not known when building
+		bool adaptive = false;
+		/// Stop adding states when the cached suffixes take this many bytes
+		size_t maxBytes = 16 * 1024 * 1024;
+	};
+
+	/// Set up the completion cache, clears all cached states
+	/// Prefill is done on the next build or now if already built
+	void setCacheSettings(const CacheSettings &settings);
+
+	/// Number of queries served from the cache since the last build
+	uint64_t getCacheHits() const {
+		return cacheHits;
+	}
+
+	/// Number of queries that had to enumerate suffixes since the last build
+	uint64_t getCacheMisses() const {
+		return cacheMisses;
+	}
+
+	/// Number of states in the completion cache
+	int getNumberOfCachedStates() const;
+
+	/// Approximate bytes used by the completion cache
+	size_t getCacheMemoryUsage() const {
+		return cacheBytes;
+	}
+
+	/// Check if some word starts with the prefix, without building any suffixes
+	/// @param prefix - the prefix to search for
+	/// @return true if the prefix is recognized
+	bool hasPrefix(const std::string &prefix) const {
+		return findState(prefix) != NO_STATE;
+	}
+
+	/// Get the number of words starting with a prefix, the number of suffixes getSuffixes would return
+	/// The number is the size of the suffix range of the prefix state, no suffix is built
+	/// @return the number of words or 0 if the prefix is not recognized
+	int countSuffixes(const std::string &prefix) const;
+
+	/// Get the number of words in the automata smaller than a string, which does not have to be a word
+	/// The words of all smaller siblings on the path of @word are added, so it takes O(length * transitions)
+	/// NOTE: The empty word is never in the automata and is not counted
+	int rank(const std::string &word) const;
+
+	/// Get a word starting with a prefix by its position among all such words, without building any suffix
+	/// @param prefix - the prefix of the word
+	/// @param index - the position of the word in lexicographic order, 0 for the prefix itself if it is a word
+	/// @return the index of the word for getWord or -1 if the prefix is not recognized or @index is too big
+	int select(const std::string &prefix, int index) const;
+
+	/// Get the words starting with a prefix as a range of indices for getWord, they are next to each other in the
+	/// sorted word list, so they can be read in lexicographic order without building any suffix
+	/// @param first[out] - the index of the first word
+	/// @param count[out] - the number of words, the same as countSuffixes
+	/// @return false if the prefix is not recognized, the outputs are not changed then
+	bool getWordRange(const std::string &prefix, int &first, int &count) const;
+
+	/// Called for each word matching a pattern
+	typedef std::function<void(const std::string &word)> MatchCallback;
+
+	/// Find the words matching a glob pattern, the pattern is walked together with the automata
+	/// so only the prefixes that can still match are visited
+	/// Syntax: ? is any symbol, * is any number of symbols, [abc] or [a-c] is one of the symbols,
+	///         [!a-c] or [^a-c] is any other symbol, \ makes the next symbol literal
+	/// @param pattern - the pattern, up to 63 symbols and classes (consecutive * count as one)
+	/// @param callback - called for each matching word in lexicographic order
+	/// @param limit - the maximum number of words to report
+	/// @return false if the pattern is not valid, true otherwise
+	bool match(const std::string &pattern, const MatchCallback &callback, int limit) const;
+
+	/// Enable or disable building the infix index on the next build, needed for getWordsContaining
+	/// NOTE: The index is an automata of all suffixes of all words, several times bigger than the prefix automata
+	void setInfixIndex(bool enabled) {
+		infixIndexEnabled = enabled;
+	}
+
+	/// Get the automata of all suffixes of all words
+	/// @return pointer to the infix index or nullptr if it was not built
+	const BasicAutomata *getInfixIndex() const {
+		return infixAutomata.get();
+	}
+
+	/// Get all words that contain some text anywhere in them
+	/// @param infix - the text to search for
+	/// @param matches[out] - words containing @infix are appended, each word at most once
+	/// @param limit - the maximum number of words to append
+	/// @return false if the infix index is not built or no word contains @infix, true otherwise
+	bool getWordsContaining(const std::string &infix, WordList &matches, int limit) const;
+
 	/// Get the default implementation of GraphDump that will write the data in graph-viz format
 	/// @param filePath - the file path where the file will be created
 	/// @return pointer to the implementation or nullptr if it fails to init with filePath
 	GraphDump *getDefaultGraphDump(const std::string &filePath);
 
+	/// Get implementation of GraphDump that writes compact binary edge list, see BinaryEdgeList for the format
+	/// @param filePath - the file path where the file will be created
+	/// @return pointer to the implementation or nullptr if it fails to init with filePath
+	GraphDump *getBinaryGraphDump(const std::string &filePath);
+
 	/// Dump the internal graph structure using GraphDump interface
 	/// @param graphDump - pointer to implementation of GraphDump
 	/// @return true if graphDump was not nullptr, false otherwise
@@ -107,9 +528,46 @@ struct Automata {
 	/// Get the number of states with in the internal graph
 	/// @return - the number of states, at least 1
 	int getNumberOfStates() const {
-		return allStates.size() - freeStates.size();
+		return int(frozenStates.size());
+	}
+
+	/// Get the number of transitions in the frozen automata
+	int getNumberOfEdges() const {
+		return int(edgeTargets.size());
 	}
 
+	/// Get the number of states a representation with the chains of non final states with a single transition collapsed
+	/// into one edge would have, the frozen automata keeps all states even with path compression
+	int getNumberOfCompressedStates() const {
+		return getNumberOfStates() - getNumberOfChainStates();
+	}
+
+	/// Get the number of transitions a representation with the chains collapsed into one edge would have
+	int getNumberOfCompressedEdges() const {
+		return getNumberOfEdges() - getNumberOfChainStates();
+	}
+
+	/// Enable or disable path compression on the next build, disabled by default
+	/// When enabled, findState compares the labels of a whole chain of states with a single transition at once (SHAPE_CHAIN)
+	/// The states of the chain are kept, so this only shortens the lookup and pays off only for long chains
+	void setPathCompression(bool enabled) {
+		pathCompression = enabled;
+	}
+
+	/// Place the frozen states, transitions and suffixes in huge pages, disabled by default
+	/// Applies to the next builds and right away to the current automata by copying its arrays
+	/// NOTE: Must not be called while other threads query the automata
+	void setHugePages(bool enabled);
+
+	/// Get the bytes of the frozen arrays placed in memory mapped for huge pages
+	size_t getHugePageBytes() const;
+
+	/// Get the number of frozen states that use a given transition shape
+	int getNumberOfStatesWithShape(TransitionShape shape) const;
+
+	/// Approximate memory in bytes used by the frozen automata, the word list and the infix index
+	size_t getMemoryUsage() const;
+
 	/// Number of words recognized by the automata
 	int getNumberOfWords() const {
 		return words.size();
@@ -120,27 +578,127 @@ struct Automata {
 		return totalSymbols;
 	}
 
-	/// Slow check for all prefixes and all suffixes in the automata
-	/// NOTE: Does nothing in Release
-	bool runVerify() const;
+	/// Number of words dropped from the word list because they contain symbols outside of the alphabet
+	int getNumberOfSkippedWords() const {
+		return skippedWords;
+	}
+
+	/// Check that the automata recognizes exactly the word list, that the suffixes of each state are correct
+	/// and that the graph is acyclic and minimal. Works in Release too, asserts on failure in Debug
+	/// @param threads - number of threads to split the words and states between, 0 to use all cores
+	/// @return true if everything matches, false otherwise
+	bool runVerify(int threads = 0) const;
+
+	/// Enumerates the words of a frozen state in lexicographic order with an explicit stack instead of recursion
+	struct WordCursor {
+		/// Start enumerating the words starting from a state, the cursor is before the first word
+		/// @param automata - the automata, must not be rebuilt while the cursor is used
+		/// @param state - the start state, the words are relative to it
+		void reset(const BasicAutomata &automata, StateId state);
+
+		/// Move the cursor so that the next word is the first one not less than @key
+		void seek(const std::string &key);
+
+		/// Advance to the next word
+		/// @return false if there are no more words
+		bool next();
+
+		/// The current word, valid after next() returned true
+		const std::string &word() const {
+			return current;
+		}
+
+	private:
+		struct Frame {
+			StateId state;
+			/// Index of the next transition to take, -1 if the state itself is not yet visited
+			int edge;
+		};
+		const BasicAutomata *automata = nullptr;
+		/// The path from the start state, current has one symbol less than the number of frames
+		std::vector<Frame> stack;
+		std::string current;
+	};
+
+	/// Start enumerating the suffixes of a prefix with a cursor
+	/// @param prefix - the prefix to search for
+	/// @param cursor[out] - reset to the state of @prefix, the words it enumerates are the suffixes
+	/// @return false if the prefix is not recognized, the cursor is not changed then
+	bool getCursor(const std::string &prefix, WordCursor &cursor) const;
 
 	/// Disable copy
-	Automata(const Automata &) = delete;
+	BasicAutomata(const BasicAutomata &) = delete;
 	/// Disable operator=
-	Automata& operator=(const Automata &) = delete;
+	BasicAutomata& operator=(const BasicAutomata &) = delete;
+
+	/// How the suffixes of a state are hashed for the registry of unique states while building
+	enum HashStrategy : uint8_t {
+		/// Xor of the hashes of all suffixes
+		HASH_XOR = HASH_STRATEGY_XOR,
+		/// Sum of all symbols of all suffixes
+		HASH_SUM = HASH_STRATEGY_SUM,
+		/// Combined hashes of the sorted suffixes
+		HASH_SORT = HASH_STRATEGY_SORT,
+	};
+
+	/// Set the hash strategy for the next build, HASH_STRATEGY by default
+	void setHashStrategy(HashStrategy strategy) {
+		hashStrategy = strategy;
+	}
+
+	HashStrategy getHashStrategy() const {
+		return hashStrategy;
+	}
+
+	/// Stats of the registry of unique states from the last build
+	struct HashStats {
+		/// Number of times the registry compared two states
+		int64_t comparisons = 0;
+		/// Comparisons of two states with the same hash where the states were equal
+		int64_t truePositives = 0;
+		/// Comparisons of two states with the same hash where the states were different
+		int64_t falsePositives = 0;
+
+		/// The rest is only collected with diagnostics enabled
+		/// Nanoseconds spent in State::slowEqual
+		int64_t slowEqualTime = 0;
+		/// Number of states and buckets of the registry at the end of the build
+		size_t registrySize = 0;
+		size_t buckets = 0;
+		/// Number of registered states with the same hash as some other registered state
+		size_t sharedHashes = 0;
+		/// bucketLoads[n] is the number of buckets with n states, the last one also counts all bigger buckets
+		std::vector<size_t> bucketLoads;
+		/// Number of states in the biggest bucket
+		size_t maxBucketLoad = 0;
+	};
+
+	/// Enable or disable the slow parts of HashStats on the next build, disabled by default
+	/// Timing each slowEqual call slows down the build
+	void setHashDiagnostics(bool enabled) {
+		hashDiagnostics = enabled;
+	}
+
+	const HashStats &getHashStats() const {
+		return hashStats;
+	}
 
 	/// Performance stat for building the collisions
 	int64_t getBuildCollisions() const {
-		return collisions;
+		return hashStats.comparisons;
 	}
 private:
+	/// The arrays of the frozen automata, placed in huge pages with setHugePages
+	template <typename T>
+	using FrozenVector = std::vector<T, HugePageAllocator<T>>;
+
 	/// Internal structure that holds a single state of the automata
 	struct State {
 		/// Both need to be ordered so that their hash depends on contents only and not on order of insertion
-		/// TODO: Change to hash map and last symbol
-		typedef std::map<symbol, State *> ConnectionMap;
+		typedef TransitionMap<Alphabet, State *> ConnectionMap;
 
 		/// Maps word index to offset in that word in the Automata word list, thus avoiding storing actual words in each state
+		/// Used for the suffixes of the frozen states, while building they are in a SuffixChunkList
 		struct Suffix {
 			int wordIndex = -1;
 			int offset = -1;
@@ -150,7 +708,7 @@ private:
 				, offset(offset)
 			{}
 		};
-		typedef std::vector<Suffix> SuffixList;
+		typedef FrozenVector<Suffix> SuffixList;
 
 		/// Find a child connection for a symbol, can be nullptr if not found
 		/// @param transition - the symbol trying to find in the connections
@@ -170,16 +728,17 @@ private:
 		void addConnection(symbol transition, State *child);
 
 		/// Append suffix to this state
-		/// @param automata - used to rebuild the hash of the suffixes when they change
+		/// @param pool - the chunks for the suffixes are allocated from here
 		/// @param wordIndex - the word that the suffix is in
 		/// @param offset - the offset in the word where the suffix starts
-		void appendSuffix(const Automata &automata, int wordIndex, int offset);
+		void appendSuffix(SuffixChunkPool &pool, int wordIndex, int offset);
 
 		/// Init own suffixes list from a "parent" state and transition symbol to this
 		/// @param automata - the automata is used to obtain the value for the actual suffixes
+		/// @param pool - the chunks for the suffixes are allocated from here
 		/// @param parent - the parent state to read suffixes from
 		/// @param transition - the symbol used to reach this from parent
-		void initSuffixesFrom(const Automata &automata, const State &parent, symbol transition);
+		void initSuffixesFrom(const BasicAutomata &automata, SuffixChunkPool &pool, const State &parent, symbol transition);
 
 		/// Replace an already inserted connection with new state, used when new child state is already in registry
 		/// @param newChild - the new value for the transition
@@ -193,7 +752,7 @@ private:
 
 		/// Get the hash of this state's connections, suffixes, and final flag
 		/// @return the hash
-		size_t getHash(const Automata &automata) const;
+		size_t getHash(const BasicAutomata &automata) const;
 
 		/// Get the number of connections starting from this state
 		/// @return - the number of connections
@@ -202,29 +761,35 @@ private:
 		/// Get all suffixes starting from this state
 		/// @param automata - the automata as suffixes need to be obtained from the word list
 		/// @param stringSuffixes[out] - set where all suffixes will be inserted
-		void buildSuffixes(const Automata &automata, WordList &stringSuffixes) const;
+		void buildSuffixes(const BasicAutomata &automata, WordList &stringSuffixes) const;
 
 		/// Clear all internal data for this state
-		void clear();
+		/// @param pool - the chunks of the suffixes are returned here
+		void clear(SuffixChunkPool &pool);
 
 		/// Equality check between two states, slow as it performs deep check and not just hash compare
 		/// @param automata - used to get the actual values for the suffixes
 		/// @param other - the state to compare to
 		/// @return true if both this and other are equal, false otherwise
-		bool slowEqual(const Automata &automata, const State &other) const;
+		bool slowEqual(const BasicAutomata &automata, const State &other) const;
 
-		/// Dump the graph starting at this state to a GraphDump, calls the same method for all connections
-		/// @param graphDump - implementation of GraphDump
-		void dumpGraph(GraphDump &graphDump) const;
+		/// Read only access to the transitions, used when freezing
+		const ConnectionMap &getConnections() const {
+			return connections;
+		}
+
+		/// Read only access to the suffixes, used when freezing
+		const SuffixChunkList &getSuffixList() const {
+			return suffixes;
+		}
 
-		/// Verify that the graph starting at this state is acyclic
-		/// when called on root state will check that there are no cycles in the whole automata
-		/// @param visited - set of all states visited to reach this one
-		/// @return true if no cycle found, false otherwise
-		bool verifyAcyclicity(std::unordered_set<const State *> &visited) const;
+		/// The id of the state in the frozen automata, NO_STATE until freeze numbers it
+		StateId getFrozenId() const {
+			return frozenId;
+		}
 
-		State() {
-			suffixes.reserve(32);
+		void setFrozenId(StateId id) const {
+			frozenId = id;
 		}
 
 	private:
@@ -234,99 +799,151 @@ private:
 		/// Suffixes are not stored as strings, but instead as a pair of indices:
 		/// key = index in the Automata::words member
 		/// value = the offset in this word where the suffix starts
-		SuffixList suffixes;
+		SuffixChunkList suffixes;
 		/// Flag set to true if some word ends with this state
 		bool isFinal = false;
+		/// Set by freeze, kept in the state so numbering needs no map from states to ids
+		mutable StateId frozenId = NO_STATE;
 		/// Hash of this state's connections, used for de-duplication of states in Automata::registry
 		mutable size_t hashConnections = 42;
 		/// Hash of this state's suffixes, used for de-duplication of states in Automata::registry
 		mutable size_t hashSuffixes = 42;
 
-		/// Build unique string for this State used for GraphDump
-		std::string buildIdString() const;
-
 		/// Re-compute the hashConnections member, needs to be called when connections change
 		void rebuildConnectionsHash() const;
 
 		/// Re-compute the hashSuffixes member, needs to be called when suffixes change
 		/// @param automata - the automata is needed because suffixes are stored as indices in the word list
-		void rebuildSuffixesHash(const Automata &automata) const;
+		void rebuildSuffixesHash(const BasicAutomata &automata) const;
 	};
 
 	/// Default implementation dumping the data into graph-viz format
 	struct DotGraphViz : GraphDump {
-		typedef std::unordered_map<std::string, std::string> EdgeToNode;
-		typedef std::unordered_map<std::string, EdgeToNode> Graph;
-
 		/// The file stream where the data will be written
 		std::fstream file;
-		/// The graph data stored to make sure not to write duplicate edges
-		Graph graph;
 
-		void start() override {}
+		void start(uint32_t, uint32_t) override {
+			file << "digraph G {\n";
+		}
 
 		void done() override {
 			flush();
 		}
 
 		bool init(const std::string &path) {
-			graph.clear();
 			file.open(path, std::ios::out);
 			if (!file) {
 				std::cout << "Failed to write viz";
 				return false;
 			}
-			file << "digraph G {" << std::endl;
 			return true;
 		}
 
 		void flush() {
 			if (file) {
-				file << "}";
-				file.flush();
+				file << "}" << std::endl;
 				file.close();
 			}
 		}
 
-		bool addConnection(const std::string& from, const std::string& to, const std::string& label) {
-			const Graph::iterator it = graph.find(from);
-			if (it == graph.end()) {
-				graph[from][to] = label;
-				return true;
+		void addVertex(uint32_t id, bool isFinal) override {
+			if (isFinal) {
+				file << id << " [ shape = doublecircle ]\n";
 			}
-			const EdgeToNode::iterator edge = it->second.find(to);
-			if (edge == it->second.end()) {
-				it->second[to] = label;
-				return true;
+		}
+
+		void addEdge(uint32_t from, uint32_t to, symbol label) override {
+			file << from << " -> " << to << " [ label = \"";
+			const unsigned char value = static_cast<unsigned char>(label);
+			if (value == '"' || value == '\\') {
+				file << '\\' << label;
+			} else if (value < 32 || value > 126) {
+				// dot files are utf-8, write the bytes that are not printable as hex
+				const char *digits = "0123456789abcdef";
+				file << "0x" << digits[value >> 4] << digits[value & 15];
+			} else {
+				file << label;
 			}
+			file << "\" ]\n";
+		}
+	};
 
-			return false;
+	/// Compact binary dump, all integers are little endian:
+	///   "ACEL" magic, uint32 version (1), uint32 number of vertices, uint32 number of edges
+	///   one byte for each vertex, 1 if final 0 otherwise
+	///   9 bytes for each edge: uint32 from, uint32 to, the label byte
+	struct BinaryEdgeList : GraphDump {
+		/// The file stream where the data will be written
+		std::fstream file;
+
+		bool init(const std::string &path) {
+			file.open(path, std::ios::out | std::ios::binary);
+			if (!file) {
+				std::cout << "Failed to write edge list";
+				return false;
+			}
+			return true;
 		}
 
-		void addEdge(const std::string& from, const std::string& to, const std::string& label) override {
-			if (addConnection(from, to, label)) {
-				file << "\"" << from << "\" -> \"" << to << "\" [ label = \"" << label<< "\" ] " << std::endl;
+		void start(uint32_t numVertices, uint32_t numEdges) override {
+			file.write("ACEL", 4);
+			writeUint(1);
+			writeUint(numVertices);
+			writeUint(numEdges);
+		}
+
+		void addVertex(uint32_t, bool isFinal) override {
+			file.put(isFinal ? 1 : 0);
+		}
+
+		void addEdge(uint32_t from, uint32_t to, symbol label) override {
+			writeUint(from);
+			writeUint(to);
+			file.put(label);
+		}
+
+		void done() override {
+			if (file) {
+				file.close();
 			}
 		}
+
+		void writeUint(uint32_t value) {
+			const char bytes[4] = {char(value), char(value >> 8), char(value >> 16), char(value >> 24)};
+			file.write(bytes, sizeof(bytes));
+		}
 	};
 
-	/// Checks if the automata will find all suffixes for a given prefix comparing the list of recognized words
-	/// NOTE: Does nothing in Release
-	/// @param start - the index of the word that the prefix is taken from
-	/// @param prefix - the prefix
-	/// @return true if all suffixes in the word list are correctly returned by getSuffixes
-	bool verifyPrefix(int start, const std::string &prefix) const;
+	/// Check that the words of the automata from words[first] on are exactly words[first, last)
+	/// and the next one is words[last], in a single pass of WordCursor
+	/// @return true if the range matches
+	bool verifyWordRange(int first, int last) const;
+
+	/// Check that the suffix range of each state in [first, last) matches its words
+	/// @return true if all ranges match
+	bool verifySuffixRanges(StateId first, StateId last) const;
+
+	/// Check that the frozen graph is acyclic with topological sort and that all states are reachable from the root
+	bool verifyAcyclicity() const;
+
+	/// Get the number of words starting at a frozen state
+	uint32_t getStateCount(StateId state) const {
+		return suffixRanges[state].count + frozenStates[state].isFinal;
+	}
+
+	/// Check that no two frozen states are equivalent and there are no dead states
+	/// Bottom up it is enough that no two states have the same final flag and transitions
+	bool verifyMinimality() const;
 
 	/// Wrapper over State* to provide custom hash and operator==
 	struct StatePtr {
-		Automata *automata = nullptr;
+		BasicAutomata *automata = nullptr;
 		State *state = nullptr;
 
 		bool operator==(const StatePtr &other) const {
 			ac_assert(state);
 			ac_assert(other.state);
-			++(automata->collisions);
-			return state->slowEqual(*automata, *other.state);
+			return automata->registryEqual(*state, *other.state);
 		}
 
 		struct Hasher {
@@ -337,7 +954,36 @@ private:
 	};
 
 	/// Hash set of all unique states
-	typedef std::unordered_set<StatePtr, StatePtr::Hasher> Registry;
+	typedef std::unordered_set<StatePtr, typename StatePtr::Hasher> Registry;
+
+	/// Read only, flat version of State, created after the automata is built
+	struct FrozenState {
+		/// Index of the first transition in edgeLabels and edgeTargets, transitions are in increasing rank order
+		uint32_t firstEdge = 0;
+		union {
+			/// Index of the bitmap in edgeBitmaps, only for SHAPE_BITMAP
+			uint32_t bitmap = 0;
+			/// Number of states in the chain, only for SHAPE_CHAIN
+			uint32_t chainLength;
+		};
+		/// Number of transitions, up to the size of the alphabet
+		uint16_t numEdges = 0;
+		/// TransitionShape used to search the labels
+		uint8_t shape = SHAPE_LINEAR;
+		/// Flag set to true if some word ends with this state
+		uint8_t isFinal = 0;
+	};
+
+	/// Range of suffixes in frozenSuffixes for a frozen state, kept apart from FrozenState so it does not slow down findState
+	struct SuffixRange {
+		uint32_t first = 0;
+		uint32_t count = 0;
+	};
+
+	/// Number of 64bit words needed for the bitmap of all ranks of the alphabet
+	static constexpr int BITMAP_WORDS = (Alphabet::size + 63) / 64;
+	/// Extra labels at the end of edgeLabels so SIMD loads never read past the end
+	static constexpr int LABEL_PADDING = 32;
 
 	/// Instead of allocating new states directly on the heap, they are added to this list
 	/// This allows de-allocation to be easier to implement (the isn't any)
@@ -346,28 +992,139 @@ private:
 	/// A queue of states that were replaced and are therefor available to be used again
 	/// When "allocating" new state, first freeStates is checked and if empty then new state is added to allStates
 	std::queue<State*> freeStates;
+	/// The chunks of the suffixes of all states in allStates
+	SuffixChunkPool suffixPool;
+	/// Buffers for the suffixes compared by State::slowEqual, kept between calls to reuse their memory
+	/// Each automata has its own, so several automata can be built at the same time
+	mutable WordList equalSuffixes[2];
 	/// The starting point for automata traversal, contains all words, the first item in allStates
+	/// The build graph is released after freezing, so this is nullptr outside of build
 	State *rootState = nullptr;
 	/// Set of all unique states in the automata, if new state is created and is already "in" the registry,
 	/// then the new state is discarded and replaced by the one in the registry
 	Registry registry;
 	/// Stores all the words this automata recognizes, used to minimize memory in the states
 	WordList words;
+	/// All frozen states, indexed by StateId
+	FrozenVector<FrozenState> frozenStates;
+	/// The suffixes of each frozen state, indexed by StateId
+	FrozenVector<SuffixRange> suffixRanges;
+	/// The labels of all transitions, packed for each state, followed by LABEL_PADDING zeros
+	FrozenVector<symbol> edgeLabels;
+	/// The target state of all transitions, parallel to edgeLabels
+	FrozenVector<StateId> edgeTargets;
+	/// BITMAP_WORDS words for each state with SHAPE_BITMAP
+	FrozenVector<uint64_t> edgeBitmaps;
+	/// The suffixes of all frozen states
+	typename State::SuffixList frozenSuffixes;
+	/// Automata recognizing all suffixes of all words, only built when infixIndexEnabled is set
+	std::unique_ptr<BasicAutomata> infixAutomata;
+	/// For each word of infixAutomata, the start of the range in infixOwners of words ending with it
+	std::vector<uint32_t> infixOwnersStart;
+	/// Indices in words of the words that each suffix in infixAutomata belongs to
+	std::vector<uint32_t> infixOwners;
+	/// Set to build the infixAutomata together with the automata
+	bool infixIndexEnabled = false;
+	/// Set to use SHAPE_CHAIN when freezing
+	bool pathCompression = false;
+
+	/// Suffixes of a cached state
+	struct CacheEntry {
+		WordList suffixes;
+		/// True if suffixes contains all suffixes of the state and not just the first CacheSettings::completions
+		bool complete = false;
+	};
+	CacheSettings cacheSettings;
+	/// Cached states, guarded by cacheMutex since adaptive caching changes it in const queries
+	mutable std::unordered_map<StateId, CacheEntry> cache;
+	mutable std::shared_timed_mutex cacheMutex;
+	/// One bit per frozen state, set on the first miss of the state when CacheSettings::adaptive is on
+	mutable std::vector<std::atomic<uint64_t>> cacheSeen;
+	mutable std::atomic<size_t> cacheBytes{0};
+	mutable std::atomic<uint64_t> cacheHits{0};
+	mutable std::atomic<uint64_t> cacheMisses{0};
 	/// Default implementation of GraphDump to save the internal representation in graph-viz format
 	DotGraphViz dotGraphViz;
+	/// Implementation of GraphDump saving binary edge list
+	BinaryEdgeList binaryEdgeList;
 	/// The total number of symbols in all words
 	int totalSymbols = 0;
-	/// The number of times the has of State::getHash collided
-	/// Performance stats collected while building the automata
-	int64_t collisions = 0;
+	/// The number of words removed from the list because they are not representable in the alphabet
+	int skippedWords = 0;
+	/// Hash of the suffixes of the build states
+	HashStrategy hashStrategy = HashStrategy(HASH_STRATEGY);
+	/// Collect the slow parts of hashStats when building
+	bool hashDiagnostics = false;
+	/// Place the frozen arrays in huge pages
+	bool hugePages = false;
+	/// Performance stats of the registry collected while building the automata
+	HashStats hashStats;
+
+	/// Compare two states in the registry and count the comparison in hashStats
+	bool registryEqual(const State &a, const State &b);
+
+	/// Fill the bucket loads and shared hashes of hashStats from the registry
+	void collectRegistryStats();
+
+	/// Copy the frozen arrays that do not match hugePages to memory from the matching allocator
+	void placeFrozenArrays();
 
 	/// Builds the automata from the word list
 	void build();
 
+	/// Start with empty build graph, with only the root state
+	void resetBuildStates();
+
+	/// Free the build graph, only the frozen automata is used after freeze
+	void releaseBuildStates();
+
+	/// Create the frozen states from the states reachable from rootState
+	void freeze();
+
+	/// Mark the starts of chains of consecutive states with a single transition with SHAPE_CHAIN
+	void compressChains();
+
+	/// Number of non root states with a single transition that are not final, these are collapsed by path compression
+	int getNumberOfChainStates() const;
+
+	/// Build infixAutomata and the owners of each suffix from the current words
+	void buildInfixIndex();
+
+	/// Append the suffixes of a frozen state
+	/// @param state - the state to get the suffixes of
+	/// @param suffixes[out] - the suffixes are appended here, the empty suffix first if the state is final
+	/// @param limit - the maximum number of suffixes to append
+	/// @param skip - the number of suffixes to skip before the first appended one
+	void appendSuffixes(StateId state, WordList &suffixes, int limit, uint32_t skip = 0) const;
+
+	/// Get the number of words starting at a frozen state that are smaller than a string
+	/// @param end[out] - the state reached with @word, NO_STATE if no word starts with it
+	uint32_t countSmaller(StateId state, const std::string &word, StateId &end) const;
+
+	/// Remove all cached states and reset the counters
+	void clearCache();
+
+	/// Add a state to the cache if it fits in CacheSettings::maxBytes, needs unique lock of cacheMutex
+	void addToCache(StateId state) const;
+
+	/// Try to get the suffixes of a state from the cache
+	/// @param limit - the number of suffixes needed, INT_MAX for all of them
+	/// @return true if the state was cached with at least @limit suffixes
+	bool getCachedSuffixes(StateId state, WordList &suffixes, int limit) const;
+
+	/// Cache all states up to CacheSettings::prefillDepth from the root
+	void prefillCache();
+
+	/// Find the transition of a frozen state
+	/// @param state - the id of the frozen state
+	/// @param transition - the symbol of the transition
+	/// @return the target state or NO_STATE if there is no such transition
+	StateId findFrozenChild(StateId state, symbol transition) const;
+
 	/// Find the last state for a given prefix
 	/// @param prefix - some string to find state for
-	/// @return pointer to the state where all suffixes for @prefix start or nullptr if prefix is not recognized
-	const State *findState(const std::string &prefix) const;
+	/// @return the id of the frozen state where all suffixes for @prefix start or NO_STATE if prefix is not recognized
+	StateId findState(const std::string &prefix) const;
 
 	/// Find the last state for the longest prefix of a word and update all states of the prefix for this word
 	/// @param wordIndex - the global index of the word
@@ -392,4 +1149,14 @@ private:
 	/// @param wordIndex - the global index of the word last added
 	/// @param offset - the offset in the word that start corresponds to
 	void minimize(State *start, int wordIndex, int offset);
-};
\ No newline at end of file
+};
+
+template <typename Alphabet>
+constexpr typename BasicAutomata<Alphabet>::StateId BasicAutomata<Alphabet>::NO_STATE;
+template <typename Alphabet>
+constexpr int BasicAutomata<Alphabet>::BITMAP_WORDS;
+template <typename Alphabet>
+constexpr int BasicAutomata<Alphabet>::LABEL_PADDING;
+
+/// The automata over all byte values
+typedef BasicAutomata<ByteAlphabet> Automata;
\ No newline at end of file
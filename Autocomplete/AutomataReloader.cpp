@@ -0,0 +1,191 @@
+#include "AutomataReloader.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+AutomataReloader::AutomataReloader(std::string path, int pollInterval)
+	: path(std::move(path))
+	, pollInterval(std::max(1, pollInterval))
+	, shared(std::make_shared<Shared>())
+{}
+
+AutomataReloader::~AutomataReloader() {
+	stop();
+}
+
+bool AutomataReloader::load() {
+	return rebuild();
+}
+
+void AutomataReloader::start() {
+	if (watcher.joinable()) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(shared->mutex);
+		shared->stopping = false;
+		shared->watching = true;
+	}
+	watcher = std::thread(&AutomataReloader::watch, this);
+}
+
+void AutomataReloader::stop() {
+	{
+		std::lock_guard<std::mutex> lock(shared->mutex);
+		shared->stopping = true;
+		shared->watching = false;
+	}
+	shared->signal.notify_all();
+	if (watcher.joinable()) {
+		watcher.join();
+	}
+}
+
+AutomataReloader::Stats AutomataReloader::getStats() const {
+	std::lock_guard<std::mutex> lock(statsMutex);
+	return stats;
+}
+
+bool AutomataReloader::getFileVersion(FileVersion &result) const {
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA info;
+	if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &info)) {
+		return false;
+	}
+	// 100ns ticks
+	result.modified = int64_t(uint64_t(info.ftLastWriteTime.dwHighDateTime) << 32 | info.ftLastWriteTime.dwLowDateTime);
+	result.size = int64_t(uint64_t(info.nFileSizeHigh) << 32 | info.nFileSizeLow);
+#else
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0) {
+		return false;
+	}
+#if defined(__APPLE__)
+	result.modified = int64_t(info.st_mtimespec.tv_sec) * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+	result.modified = int64_t(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+	result.size = int64_t(info.st_size);
+#endif
+	return true;
+}
+
+bool AutomataReloader::rebuild() {
+	typedef std::chrono::steady_clock clock_t;
+
+	// take the version before reading, a change while reading is picked up by the next poll
+	FileVersion latest;
+	if (!getFileVersion(latest)) {
+		std::cerr << "Failed to read from " << path << std::endl;
+		return false;
+	}
+
+	const clock_t::time_point readStart = clock_t::now();
+	Automata::WordList words;
+	{
+		std::ifstream file(path);
+		if (!file) {
+			std::cerr << "Failed to read from " << path << std::endl;
+			return false;
+		}
+		std::string line;
+		while (getline(file, line)) {
+			while (!line.empty() && (line.back() == '\r' || line.back() == '\n')) {
+				line.pop_back();
+			}
+			words.push_back(std::move(line));
+		}
+	}
+
+	const clock_t::time_point buildStart = clock_t::now();
+	std::unique_ptr<Automata> built(new Automata);
+	built->buildFromWordList(std::move(words));
+	if (onPrepare) {
+		onPrepare(*built);
+	}
+	// Freeing a big automata takes a while, the query that drops the last reference only hands it to the watcher
+	const std::shared_ptr<Shared> owner = shared;
+	const AutomataPtr dict(built.release(), [owner](const Automata *released) {
+		release(*owner, released);
+	});
+
+	const clock_t::time_point swapStart = clock_t::now();
+	AutomataPtr previous = std::atomic_exchange(&current, dict);
+	const clock_t::time_point swapEnd = clock_t::now();
+	version = latest;
+
+	Stats result;
+	{
+		std::lock_guard<std::mutex> lock(statsMutex);
+		stats.builds++;
+		stats.readTime = std::chrono::duration_cast<std::chrono::milliseconds>(buildStart - readStart).count();
+		stats.buildTime = std::chrono::duration_cast<std::chrono::milliseconds>(swapStart - buildStart).count();
+		stats.swapTime = std::chrono::duration_cast<std::chrono::nanoseconds>(swapEnd - swapStart).count();
+		stats.words = dict->getNumberOfWords();
+		stats.states = dict->getNumberOfStates();
+		result = stats;
+	}
+
+	previous.reset();
+
+	if (onSwap) {
+		onSwap(result);
+	}
+	return true;
+}
+
+void AutomataReloader::release(Shared &shared, const Automata *dict) {
+	{
+		std::lock_guard<std::mutex> lock(shared.mutex);
+		if (shared.watching) {
+			shared.released.push_back(dict);
+			shared.signal.notify_all();
+			return;
+		}
+	}
+	delete dict;
+}
+
+void AutomataReloader::watch() {
+	typedef std::chrono::steady_clock clock_t;
+
+	FileVersion seen = version;
+	clock_t::time_point nextPoll = clock_t::now() + pollInterval;
+	while (true) {
+		std::vector<const Automata *> released;
+		bool stopped = false;
+		{
+			std::unique_lock<std::mutex> lock(shared->mutex);
+			shared->signal.wait_until(lock, nextPoll, [this] { return shared->stopping || !shared->released.empty(); });
+			released.swap(shared->released);
+			stopped = shared->stopping;
+		}
+		for (const Automata *dict : released) {
+			delete dict;
+		}
+		if (stopped) {
+			return;
+		}
+		if (clock_t::now() < nextPoll) {
+			continue;
+		}
+		nextPoll = clock_t::now() + pollInterval;
+
+		FileVersion latest;
+		if (!getFileVersion(latest) || latest == version) {
+			seen = latest;
+			continue;
+		}
+		// wait until the file stays the same for a whole interval, it may still be written
+		if (latest != seen) {
+			seen = latest;
+			continue;
+		}
+		rebuild();
+	}
+}
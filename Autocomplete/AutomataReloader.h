@@ -0,0 +1,119 @@
+#pragma once
+
+#include "Automata.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <thread>
+
+/// Keeps an automata built from a word list file and rebuilds it on a background thread when the file changes
+/// Queries keep using the current automata while a new one is built, the new one replaces it with a single pointer swap
+struct AutomataReloader {
+	typedef std::shared_ptr<const Automata> AutomataPtr;
+
+	/// @param path - the word list, one word on each line
+	/// @param pollInterval - milliseconds between checks of the modification time of the file
+	explicit AutomataReloader(std::string path, int pollInterval = 500);
+	~AutomataReloader();
+
+	AutomataReloader(const AutomataReloader &) = delete;
+	AutomataReloader &operator=(const AutomataReloader &) = delete;
+
+	/// Build the first automata on the calling thread
+	/// @return false if the file could not be read
+	bool load();
+
+	/// Start watching the file on a background thread, load must have succeeded before
+	void start();
+
+	/// Stop watching and wait for a rebuild in progress to finish
+	void stop();
+
+	/// Get the current automata, safe to call from any thread while a rebuild is in progress
+	/// The automata stays valid as long as the returned pointer is kept, even if it is replaced in the meantime
+	/// Keep it only for a query or a batch of them, the replaced automata is freed once no query uses it
+	AutomataPtr get() const {
+		return std::atomic_load(&current);
+	}
+
+	/// Times of the last rebuild, all 0 before the first one
+	struct Stats {
+		/// Number of automata built, including the one from load
+		int builds = 0;
+		/// Milliseconds to read the file and build the automata, the build includes the prepare callback
+		int64_t readTime = 0;
+		int64_t buildTime = 0;
+		/// Nanoseconds to replace the current automata
+		int64_t swapTime = 0;
+		/// Number of words and states of the current automata
+		int words = 0;
+		int states = 0;
+	};
+
+	Stats getStats() const;
+
+	/// Callback called with each new automata before it replaces the current one, to change its settings or dump it
+	typedef std::function<void(Automata &dict)> PrepareCallback;
+	void setPrepareCallback(PrepareCallback callback) {
+		onPrepare = std::move(callback);
+	}
+
+	/// Callback called on the background thread after each swap
+	typedef std::function<void(const Stats &stats)> SwapCallback;
+	void setSwapCallback(SwapCallback callback) {
+		onSwap = std::move(callback);
+	}
+
+private:
+	/// Modification time and size of the file, the file is rebuilt when any of them changes
+	/// The time is in nanoseconds (100ns ticks on Windows), but only as fine as the file system keeps it, so a rewrite
+	/// with the same size within one tick of the file system's clock is not noticed
+	struct FileVersion {
+		int64_t modified = -1;
+		int64_t size = -1;
+
+		bool operator==(const FileVersion &other) const {
+			return modified == other.modified && size == other.size;
+		}
+		bool operator!=(const FileVersion &other) const {
+			return !(*this == other);
+		}
+	};
+
+	std::string path;
+	std::chrono::milliseconds pollInterval;
+	AutomataPtr current;
+	FileVersion version;
+
+	mutable std::mutex statsMutex;
+	Stats stats;
+	PrepareCallback onPrepare;
+	SwapCallback onSwap;
+
+	/// State of the watcher shared with the deleter of each automata, which can run after the reloader is destroyed
+	struct Shared {
+		std::mutex mutex;
+		std::condition_variable signal;
+		bool stopping = false;
+		/// Set while the watcher runs, the automata released meanwhile are freed by it
+		bool watching = false;
+		std::vector<const Automata *> released;
+	};
+
+	std::thread watcher;
+	std::shared_ptr<Shared> shared;
+
+	/// Deleter of the automata: hand it to the watcher, or free it on the calling thread if there is no watcher
+	static void release(Shared &shared, const Automata *dict);
+
+	/// Get the version of the file
+	/// @return false if the file does not exist
+	bool getFileVersion(FileVersion &result) const;
+
+	/// Read the file and build a new automata, then swap it with the current one
+	/// @return false if the file could not be read
+	bool rebuild();
+
+	/// Poll the file until stop is called
+	void watch();
+};
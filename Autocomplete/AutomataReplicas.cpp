@@ -0,0 +1,144 @@
+#include "AutomataReplicas.h"
+
+#include <cstdlib>
+#include <thread>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#endif
+
+namespace
+{
+
+#ifdef __linux__
+/// Parse a list of numbers and ranges like "0-3,8,10-11" as used in /sys/devices/system
+std::vector<int> parseList(const std::string &list) {
+	std::vector<int> result;
+	size_t position = 0;
+	while (position < list.size()) {
+		char *end = nullptr;
+		const long first = strtol(list.c_str() + position, &end, 10);
+		if (end == list.c_str() + position) {
+			break;
+		}
+		long last = first;
+		if (*end == '-') {
+			const char *start = end + 1;
+			last = strtol(start, &end, 10);
+		}
+		for (long c = first; c <= last; c++) {
+			result.push_back(int(c));
+		}
+		position = end - list.c_str();
+		if (position < list.size() && list[position] == ',') {
+			++position;
+		} else {
+			break;
+		}
+	}
+	return result;
+}
+
+/// Read the first line of a file, empty if it can not be read
+std::string readLine(const std::string &path) {
+	std::ifstream file(path);
+	std::string line;
+	getline(file, line);
+	return line;
+}
+
+/// The CPUs of a node
+std::vector<int> getNodeCpus(int node) {
+	return parseList(readLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"));
+}
+
+/// The node of each CPU, read once
+const std::vector<int> &getCpuNodes() {
+	static const std::vector<int> cpuNodes = []() {
+		std::vector<int> result;
+		for (const int node : parseList(readLine("/sys/devices/system/node/online"))) {
+			for (const int cpu : getNodeCpus(node)) {
+				if (cpu >= int(result.size())) {
+					result.resize(cpu + 1, 0);
+				}
+				result[cpu] = node;
+			}
+		}
+		return result;
+	}();
+	return cpuNodes;
+}
+#endif
+
+}
+
+void AutomataReplicas::build(const Automata::WordList &words, bool hugePages) {
+	const int nodes = getNumberOfNodes();
+	replicas.assign(nodes, nullptr);
+
+	std::vector<std::thread> builders;
+	for (int node = 0; node < nodes; node++) {
+		builders.emplace_back([this, &words, hugePages, node]() {
+			// without the affinity the copy is still complete, only its memory may be on another node
+			runOnNode(node);
+			std::shared_ptr<Automata> dict(new Automata);
+			dict->setHugePages(hugePages);
+			dict->buildFromWordList(words);
+			replicas[node] = dict;
+		});
+	}
+	for (std::thread &builder : builders) {
+		builder.join();
+	}
+}
+
+int AutomataReplicas::getNumberOfNodes() {
+#ifdef _WIN32
+	ULONG highest = 0;
+	return GetNumaHighestNodeNumber(&highest) ? int(highest) + 1 : 1;
+#elif defined(__linux__)
+	const std::vector<int> nodes = parseList(readLine("/sys/devices/system/node/online"));
+	return nodes.empty() ? 1 : *std::max_element(nodes.begin(), nodes.end()) + 1;
+#else
+	return 1;
+#endif
+}
+
+int AutomataReplicas::getCurrentNode() {
+#ifdef _WIN32
+	PROCESSOR_NUMBER processor;
+	GetCurrentProcessorNumberEx(&processor);
+	USHORT node = 0;
+	return GetNumaProcessorNodeEx(&processor, &node) ? int(node) : 0;
+#elif defined(__linux__)
+	const int cpu = sched_getcpu();
+	const std::vector<int> &cpuNodes = getCpuNodes();
+	return cpu >= 0 && cpu < int(cpuNodes.size()) ? cpuNodes[cpu] : 0;
+#else
+	return 0;
+#endif
+}
+
+bool AutomataReplicas::runOnNode(int node) {
+#ifdef _WIN32
+	GROUP_AFFINITY affinity = {};
+	return GetNumaNodeProcessorMaskEx(USHORT(node), &affinity) && affinity.Mask &&
+		SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr);
+#elif defined(__linux__)
+	const std::vector<int> cpus = getNodeCpus(node);
+	if (cpus.empty()) {
+		return false;
+	}
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (const int cpu : cpus) {
+		CPU_SET(cpu, &set);
+	}
+	return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+	return false;
+#endif
+}
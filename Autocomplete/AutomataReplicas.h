@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Automata.h"
+
+/// A copy of an automata for each NUMA node, so queries do not read memory of another node
+/// Each copy is built by a thread running only on the CPUs of its node and the memory of a thread is placed on the node
+/// it first touches it from, so the whole copy is local to the node without any NUMA library.
+/// Systems without NUMA information have a single node and a single copy.
+struct AutomataReplicas {
+	typedef std::shared_ptr<const Automata> AutomataPtr;
+
+	/// Build a copy for each node, in parallel
+	/// @param words - the word list
+	/// @param hugePages - place the frozen arrays of each copy in huge pages, see BasicAutomata::setHugePages
+	void build(const Automata::WordList &words, bool hugePages);
+
+	/// Get the copy of the node the calling thread runs on
+	AutomataPtr get() const {
+		const int node = getCurrentNode();
+		return replicas[node < int(replicas.size()) ? node : 0];
+	}
+
+	/// Get the copy of a node
+	AutomataPtr get(int node) const {
+		return replicas[node];
+	}
+
+	int getNumberOfReplicas() const {
+		return int(replicas.size());
+	}
+
+	/// Get the highest online NUMA node + 1, at least 1
+	/// Node numbers may have gaps and nodes may have no CPUs, those get a copy too, which get() never returns
+	static int getNumberOfNodes();
+
+	/// Get the NUMA node of the CPU the calling thread runs on, 0 if it is not known
+	static int getCurrentNode();
+
+	/// Run the calling thread only on the CPUs of a node
+	/// @return false if the node has no CPUs or the affinity could not be set
+	static bool runOnNode(int node);
+
+private:
+	std::vector<AutomataPtr> replicas;
+};
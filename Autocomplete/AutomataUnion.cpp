@@ -0,0 +1,75 @@
+#include "AutomataUnion.h"
+
+bool AutomataUnion::hasPrefix(const std::string &prefix) const {
+	for (const AutomataPtr &dict : dicts) {
+		if (dict->hasPrefix(prefix)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool AutomataUnion::getSuffixes(const std::string &prefix, Automata::WordList &suffixes, int limit) const {
+	// the words with the prefix are a sorted range of the word list of each dictionary, the ranges are merged by
+	// reference and only the suffixes that are taken are built
+	struct Range {
+		const Automata *dict;
+		int next;
+		int end;
+
+		const std::string &word() const {
+			return dict->getWord(next);
+		}
+	};
+	std::vector<Range> heap;
+	heap.reserve(dicts.size());
+	bool found = false;
+	for (const AutomataPtr &dict : dicts) {
+		int first = 0, count = 0;
+		if (!dict->getWordRange(prefix, first, count)) {
+			continue;
+		}
+		found = true;
+		if (count > 0) {
+			heap.push_back(Range{dict.get(), first, first + count});
+		}
+	}
+
+	// the heap functions keep the largest element on top, so the order is reversed to take the smallest word first
+	const auto greater = [](const Range &a, const Range &b) {
+		return b.word() < a.word();
+	};
+	std::make_heap(heap.begin(), heap.end(), greater);
+
+	const std::string *last = nullptr;
+	int added = 0;
+	while (heap.size() > 1 && added < limit) {
+		std::pop_heap(heap.begin(), heap.end(), greater);
+		Range &range = heap.back();
+		const std::string &word = range.word();
+		// every range is sorted and unique, so a word in several dictionaries comes right after itself
+		if (!last || *last != word) {
+			suffixes.emplace_back(word, prefix.size());
+			last = &word;
+			++added;
+		}
+
+		if (++range.next < range.end) {
+			std::push_heap(heap.begin(), heap.end(), greater);
+		} else {
+			heap.pop_back();
+		}
+	}
+
+	// usually only one dictionary has the prefix, its words are copied without heap operations
+	if (!heap.empty()) {
+		Range &range = heap.back();
+		if (last && range.next < range.end && *last == range.word()) {
+			++range.next;
+		}
+		for (; range.next < range.end && added < limit; range.next++, added++) {
+			suffixes.emplace_back(range.word(), prefix.size());
+		}
+	}
+	return found;
+}
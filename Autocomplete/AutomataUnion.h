@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Automata.h"
+
+/// Query several automata as one built from the union of their word lists, without copying any of them
+/// A big base dictionary can be shared read only by the unions of many small ones
+struct AutomataUnion {
+	typedef std::shared_ptr<const Automata> AutomataPtr;
+
+	/// Add a dictionary to the union, it must not be rebuilt while in the union
+	void add(AutomataPtr dict) {
+		dicts.push_back(std::move(dict));
+	}
+
+	/// Remove all dictionaries from the union
+	void clear() {
+		dicts.clear();
+	}
+
+	/// Get the number of dictionaries in the union
+	int size() const {
+		return int(dicts.size());
+	}
+
+	/// Check if a word in any of the dictionaries starts with the prefix
+	bool hasPrefix(const std::string &prefix) const;
+
+	/// Get up to some number of suffixes for a given prefix from all dictionaries
+	/// The suffixes are in lexicographic order and each one is reported once, even if it is in several dictionaries
+	/// @param prefix - the prefix to search for
+	/// @param suffixes[out] - the first @limit suffixes for the prefix are appended
+	/// @param limit - the maximum number of suffixes to append
+	/// @return false if the prefix is not recognized by any of the dictionaries, true otherwise
+	bool getSuffixes(const std::string &prefix, Automata::WordList &suffixes, int limit) const;
+
+private:
+	std::vector<AutomataPtr> dicts;
+};
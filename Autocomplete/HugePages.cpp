@@ -0,0 +1,70 @@
+#include "HugePages.h"
+
+#include <cstdint>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace
+{
+
+inline size_t roundUp(size_t value, size_t multiple) {
+	return (value + multiple - 1) / multiple * multiple;
+}
+
+}
+
+void *allocateHugePages(size_t bytes) {
+#ifdef _WIN32
+	const size_t largePage = GetLargePageMinimum();
+	if (largePage) {
+		void *memory = VirtualAlloc(nullptr, roundUp(bytes, largePage), MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+		if (memory) {
+			return memory;
+		}
+	}
+	// large pages need SeLockMemoryPrivilege, without it this is the same as operator new
+	return VirtualAlloc(nullptr, roundUp(bytes, HUGE_PAGE_SIZE), MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#elif defined(__linux__)
+	const size_t size = roundUp(bytes, HUGE_PAGE_SIZE);
+#ifdef MAP_HUGETLB
+	void *reserved = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (reserved != MAP_FAILED) {
+		return reserved;
+	}
+#endif
+	// No reserved huge pages, map one more huge page and cut the unaligned ends so the kernel can use whole huge pages
+	char *raw = static_cast<char *>(mmap(nullptr, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+	if (raw == MAP_FAILED) {
+		return nullptr;
+	}
+	char *aligned = reinterpret_cast<char *>(roundUp(reinterpret_cast<uintptr_t>(raw), HUGE_PAGE_SIZE));
+	if (aligned != raw) {
+		munmap(raw, aligned - raw);
+	}
+	munmap(aligned + size, raw + size + HUGE_PAGE_SIZE - (aligned + size));
+#ifdef MADV_HUGEPAGE
+	madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+	return aligned;
+#else
+	return ::operator new(bytes, std::nothrow);
+#endif
+}
+
+void freeHugePages(void *memory, size_t bytes) {
+	if (!memory) {
+		return;
+	}
+#ifdef _WIN32
+	VirtualFree(memory, 0, MEM_RELEASE);
+#elif defined(__linux__)
+	munmap(memory, roundUp(bytes, HUGE_PAGE_SIZE));
+#else
+	::operator delete(memory);
+#endif
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+/// Size of the huge pages that are asked for, 2MB on x86-64 Linux and Windows
+const size_t HUGE_PAGE_SIZE = size_t(2) << 20;
+
+/// Smaller allocations are not worth a huge page of their own
+const size_t HUGE_PAGE_MIN_BYTES = HUGE_PAGE_SIZE / 2;
+
+/// Map memory backed by huge pages, rounded up to a multiple of HUGE_PAGE_SIZE
+/// Linux: reserved hugetlbfs pages (MAP_HUGETLB) if there are any, else a mapping aligned to HUGE_PAGE_SIZE and
+/// madvise(MADV_HUGEPAGE) so transparent huge pages are used when they are enabled for madvise or always.
+/// Windows: large pages if the process has SeLockMemoryPrivilege, else regular pages.
+/// Other systems use operator new.
+/// @return the memory or nullptr if there is not enough memory
+void *allocateHugePages(size_t bytes);
+
+/// Unmap memory from allocateHugePages
+/// @param bytes - the same size passed to allocateHugePages
+void freeHugePages(void *memory, size_t bytes);
+
+/// Allocator placing big arrays in huge pages when enabled, small ones and all arrays when disabled use operator new
+/// The flag moves with the memory on container copy, move and swap
+template <typename T>
+struct HugePageAllocator {
+	typedef T value_type;
+	typedef std::true_type propagate_on_container_copy_assignment;
+	typedef std::true_type propagate_on_container_move_assignment;
+	typedef std::true_type propagate_on_container_swap;
+
+	bool enabled = false;
+
+	HugePageAllocator() = default;
+
+	explicit HugePageAllocator(bool enabled)
+		: enabled(enabled)
+	{}
+
+	template <typename U>
+	HugePageAllocator(const HugePageAllocator<U> &other)
+		: enabled(other.enabled)
+	{}
+
+	T *allocate(size_t count) {
+		const size_t bytes = count * sizeof(T);
+		if (!usesHugePages(bytes)) {
+			return static_cast<T *>(::operator new(bytes));
+		}
+		void *memory = allocateHugePages(bytes);
+		if (!memory) {
+			throw std::bad_alloc();
+		}
+		return static_cast<T *>(memory);
+	}
+
+	void deallocate(T *memory, size_t count) {
+		const size_t bytes = count * sizeof(T);
+		if (usesHugePages(bytes)) {
+			freeHugePages(memory, bytes);
+		} else {
+			::operator delete(memory);
+		}
+	}
+
+	bool usesHugePages(size_t bytes) const {
+		return enabled && bytes >= HUGE_PAGE_MIN_BYTES;
+	}
+
+	template <typename U>
+	bool operator==(const HugePageAllocator<U> &other) const {
+		return enabled == other.enabled;
+	}
+
+	template <typename U>
+	bool operator!=(const HugePageAllocator<U> &other) const {
+		return enabled != other.enabled;
+	}
+};
@@ -0,0 +1,443 @@
+#include "Server.h"
+
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <random>
+#include <thread>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+typedef SOCKET socket_t;
+#define closeSocket closesocket
+#define poll WSAPoll
+typedef ULONG nfds_t;
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int socket_t;
+const socket_t INVALID_SOCKET = -1;
+#define closeSocket close
+#endif
+
+#ifndef MSG_NOSIGNAL
+// macOS and the BSDs, a write to a closed connection raises SIGPIPE unless SO_NOSIGPIPE is set on the socket
+#define MSG_NOSIGNAL 0
+#if !defined(_WIN32) && !defined(SO_NOSIGPIPE)
+#define IGNORE_SIGPIPE
+#endif
+#endif
+
+namespace
+{
+
+/// Initialize the socket library, needed only on Windows
+bool initSockets() {
+#ifdef IGNORE_SIGPIPE
+	signal(SIGPIPE, SIG_IGN);
+#endif
+#ifdef _WIN32
+	WSADATA data;
+	return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+#else
+	return true;
+#endif
+}
+
+/// Fill address for host and port
+/// @return false if host is not a valid IPv4 address
+bool makeAddress(const ServerSettings &settings, sockaddr_in &address) {
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_port = htons(uint16_t(settings.port));
+	return inet_pton(AF_INET, settings.host.c_str(), &address.sin_addr) == 1;
+}
+
+/// Disable Nagle's algorithm, responses are written at once and should not wait for more data
+/// Also disable SIGPIPE for the socket where send has no MSG_NOSIGNAL
+void setNoDelay(socket_t socket) {
+	const int enable = 1;
+	setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&enable), sizeof(enable));
+#ifdef SO_NOSIGPIPE
+	setsockopt(socket, SOL_SOCKET, SO_NOSIGPIPE, reinterpret_cast<const char *>(&enable), sizeof(enable));
+#endif
+}
+
+/// Switch the socket between blocking and non blocking mode
+void setBlocking(socket_t socket, bool blocking) {
+#ifdef _WIN32
+	u_long nonBlocking = blocking ? 0 : 1;
+	ioctlsocket(socket, FIONBIO, &nonBlocking);
+#else
+	const int flags = fcntl(socket, F_GETFL, 0);
+	fcntl(socket, F_SETFL, blocking ? flags & ~O_NONBLOCK : flags | O_NONBLOCK);
+#endif
+}
+
+/// Check if the last socket call failed only because the non blocking socket is not ready
+bool wouldBlock() {
+#ifdef _WIN32
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+	return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+/// Write the whole buffer to the socket
+/// @return false if the connection was closed
+bool sendAll(socket_t socket, const std::string &data) {
+	size_t sent = 0;
+	while (sent < data.size()) {
+		const int result = send(socket, data.data() + sent, int(data.size() - sent), MSG_NOSIGNAL);
+		if (result <= 0) {
+			return false;
+		}
+		sent += result;
+	}
+	return true;
+}
+
+/// Buffered reading of lines from a socket
+struct LineReader {
+	socket_t socket;
+	std::string buffer;
+	/// Start of the unread data in buffer
+	size_t start = 0;
+
+	explicit LineReader(socket_t socket)
+		: socket(socket)
+	{}
+
+	/// Get the next complete line already in the buffer, does not read from the socket
+	/// @param line[out] - the line without the new line symbols
+	/// @return false if there is no complete line in the buffer
+	bool nextLine(std::string &line) {
+		const size_t end = buffer.find('\n', start);
+		if (end == std::string::npos) {
+			return false;
+		}
+		line.assign(buffer, start, end - start);
+		if (!line.empty() && line.back() == '\r') {
+			line.pop_back();
+		}
+		start = end + 1;
+		return true;
+	}
+
+	/// Read whatever is available from the socket, blocks until there is some data unless the socket is non blocking
+	/// @return false if the connection was closed
+	bool fill() {
+		buffer.erase(0, start);
+		start = 0;
+		char chunk[64 * 1024];
+		const int read = recv(socket, chunk, sizeof(chunk), 0);
+		if (read < 0 && wouldBlock()) {
+			return true;
+		}
+		if (read <= 0) {
+			return false;
+		}
+		buffer.append(chunk, read);
+		return true;
+	}
+
+	/// Number of bytes received and not returned as a line yet
+	size_t pending() const {
+		return buffer.size() - start;
+	}
+
+	/// Get the next line, reading from the socket until it is complete
+	/// @return false if the connection was closed
+	bool readLine(std::string &line) {
+		while (!nextLine(line)) {
+			if (!fill()) {
+				return false;
+			}
+		}
+		return true;
+	}
+};
+
+/// A connection served by a worker, with the requests read from it and the responses not sent yet
+struct Connection {
+	LineReader reader;
+	/// Responses waiting for the socket to accept them, output[0, sent) is already sent
+	std::string output;
+	size_t sent = 0;
+	int64_t requests = 0;
+	int64_t batches = 0;
+
+	explicit Connection(socket_t socket)
+		: reader(socket)
+	{}
+
+	/// Number of response bytes not sent yet
+	size_t unsent() const {
+		return output.size() - sent;
+	}
+
+	/// Send as much of the output as the non blocking socket takes without waiting
+	/// @return false if the connection was closed
+	bool flush() {
+		while (sent < output.size()) {
+			const int result = send(reader.socket, output.data() + sent, int(output.size() - sent), MSG_NOSIGNAL);
+			if (result < 0 && wouldBlock()) {
+				return true;
+			}
+			if (result <= 0) {
+				return false;
+			}
+			sent += result;
+		}
+		output.clear();
+		sent = 0;
+		return true;
+	}
+};
+
+/// Answer the requests a readable connection has sent
+/// Everything received so far is answered at once, the responses are appended to the connection's output
+/// @return false if the connection was closed or has to be closed
+bool serveBatch(const AutomataProvider &provider, const ServerSettings &settings, Connection &connection) {
+	if (!connection.reader.fill()) {
+		return false;
+	}
+
+	std::string &response = connection.output;
+	response.erase(0, connection.sent);
+	connection.sent = 0;
+	const size_t before = response.size();
+	{
+		// the automata is released before the write, a slow client must not keep an old automata alive
+		const std::shared_ptr<const Automata> dict = provider();
+		std::string prefix;
+		Automata::WordList suffixes;
+		while (connection.reader.nextLine(prefix)) {
+			suffixes.clear();
+			dict->getSuffixes(prefix, suffixes, settings.limit);
+			response += std::to_string(suffixes.size());
+			response += '\n';
+			for (const std::string &suffix : suffixes) {
+				response += prefix;
+				response += suffix;
+				response += '\n';
+			}
+			++connection.requests;
+		}
+	}
+
+	if (response.size() > before) {
+		++connection.batches;
+		if (!connection.flush()) {
+			return false;
+		}
+	}
+	// what is left is the start of a line, which can not grow without end
+	return connection.reader.pending() <= size_t(settings.maxLineLength);
+}
+
+/// Events to poll a connection for: new requests unless too many responses are waiting, and writable while any are
+short pollEvents(const ServerSettings &settings, const Connection &connection) {
+	const size_t unsent = connection.unsent();
+	return short((unsent < size_t(settings.maxPendingOutput) ? POLLIN : 0) | (unsent ? POLLOUT : 0));
+}
+
+/// Worker loop: wait for the listener and the connections accepted by this worker, serve the ready ones
+/// All workers poll the same non blocking listener, the one that accepts a connection serves it until it is closed,
+/// together with all its other connections, so no connection waits for another one to close.
+/// Connections are non blocking too, a client reading its responses slowly only stops its own requests from being read.
+void serveConnections(const AutomataProvider &provider, const ServerSettings &settings, socket_t listener) {
+	// polled[0] is the listener, polled[c + 1] is connections[c]
+	std::vector<pollfd> polled(1);
+	polled[0].fd = listener;
+	polled[0].events = POLLIN;
+	std::vector<Connection> connections;
+
+	while (true) {
+		if (poll(polled.data(), nfds_t(polled.size()), -1) <= 0) {
+			continue;
+		}
+
+		// backwards, so a closed connection can be replaced with the last one, which was already checked
+		for (size_t c = polled.size() - 1; c > 0; c--) {
+			if (!polled[c].revents) {
+				continue;
+			}
+			Connection &connection = connections[c - 1];
+			bool open = true;
+			if (polled[c].revents & POLLOUT) {
+				open = connection.flush();
+			}
+			if (open && (polled[c].revents & (POLLIN | POLLHUP | POLLERR))) {
+				// a connection waiting only for POLLOUT is read on hang up or error, so the failure closes it
+				open = serveBatch(provider, settings, connection);
+			}
+			if (open) {
+				polled[c].events = pollEvents(settings, connection);
+				continue;
+			}
+			closeSocket(connection.reader.socket);
+			std::cout << "Connection closed, " << connection.requests << " requests in " << connection.batches << " batches" << std::endl;
+			connections[c - 1] = std::move(connections.back());
+			connections.pop_back();
+			polled[c] = polled.back();
+			polled.pop_back();
+		}
+
+		if (polled[0].revents & POLLIN) {
+			// another worker may have taken the connection already
+			const socket_t socket = accept(listener, nullptr, nullptr);
+			if (socket != INVALID_SOCKET) {
+				// not inherited from the listener on every platform
+				setBlocking(socket, false);
+				setNoDelay(socket);
+				connections.emplace_back(socket);
+				pollfd entry;
+				entry.fd = socket;
+				entry.events = POLLIN;
+				entry.revents = 0;
+				polled.push_back(entry);
+			}
+		}
+	}
+}
+
+}
+
+bool runServer(const AutomataProvider &provider, const ServerSettings &settings) {
+	sockaddr_in address;
+	if (!initSockets() || !makeAddress(settings, address)) {
+		std::cerr << "Invalid address " << settings.host << std::endl;
+		return false;
+	}
+
+	const socket_t listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	const int reuse = 1;
+	if (listener == INVALID_SOCKET ||
+		setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&reuse), sizeof(reuse)) != 0 ||
+		bind(listener, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0 ||
+		listen(listener, SOMAXCONN) != 0) {
+		std::cerr << "Failed to listen on " << settings.host << ":" << settings.port << std::endl;
+		return false;
+	}
+	setBlocking(listener, false);
+
+	std::cout << "Serving on " << settings.host << ":" << settings.port << " with " << settings.threads
+		<< " threads, limit " << settings.limit << std::endl;
+	std::vector<std::thread> workers;
+	for (int c = 1; c < settings.threads; c++) {
+		workers.emplace_back(serveConnections, std::cref(provider), std::cref(settings), listener);
+	}
+	serveConnections(provider, settings, listener);
+	return true;
+}
+
+bool runServer(const Automata &dict, const ServerSettings &settings) {
+	// the automata is owned by the caller, the pointer does not delete it
+	const std::shared_ptr<const Automata> shared(&dict, [](const Automata *) {});
+	return runServer([&shared]() { return shared; }, settings);
+}
+
+bool runLoadGenerator(const Automata::WordList &words, const ServerSettings &settings) {
+	sockaddr_in address;
+	if (!initSockets() || !makeAddress(settings, address)) {
+		std::cerr << "Invalid address " << settings.host << std::endl;
+		return false;
+	}
+
+	// random prefixes of random words, same for every run
+	std::mt19937 rng(42);
+	Automata::WordList prefixes;
+	for (int c = 0; c < 100000 && !words.empty(); c++) {
+		const std::string &word = words[rng() % words.size()];
+		prefixes.push_back(word.substr(0, word.empty() ? 0 : 1 + rng() % word.size()));
+	}
+
+	typedef std::chrono::steady_clock clock;
+	std::vector<std::vector<double>> latencies(settings.connections);
+	std::atomic<bool> failed{false};
+	std::vector<std::thread> clients;
+
+	const clock::time_point start = clock::now();
+	for (int c = 0; c < settings.connections; c++) {
+		clients.emplace_back([&, c]() {
+			const socket_t connection = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+			if (connection == INVALID_SOCKET || connect(connection, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0) {
+				failed = true;
+				return;
+			}
+			setNoDelay(connection);
+
+			LineReader reader(connection);
+			std::string request, line;
+			const int total = settings.requests / settings.connections;
+			size_t next = c * prefixes.size() / settings.connections;
+			for (int sent = 0; sent < total && !failed; ) {
+				const int batch = std::min(settings.pipeline, total - sent);
+				request.clear();
+				for (int r = 0; r < batch; r++) {
+					request += prefixes[next++ % prefixes.size()];
+					request += '\n';
+				}
+
+				const clock::time_point batchStart = clock::now();
+				if (!sendAll(connection, request)) {
+					failed = true;
+					break;
+				}
+				for (int r = 0; r < batch; r++) {
+					if (!reader.readLine(line)) {
+						failed = true;
+						break;
+					}
+					for (int count = atoi(line.c_str()); count > 0; count--) {
+						if (!reader.readLine(line)) {
+							failed = true;
+							break;
+						}
+					}
+					const std::chrono::duration<double, std::micro> latency = clock::now() - batchStart;
+					latencies[c].push_back(latency.count());
+				}
+				sent += batch;
+			}
+			closeSocket(connection);
+		});
+	}
+	for (std::thread &client : clients) {
+		client.join();
+	}
+	const std::chrono::duration<double> elapsed = clock::now() - start;
+
+	if (failed) {
+		std::cerr << "Failed to connect to " << settings.host << ":" << settings.port << " or connection dropped" << std::endl;
+		return false;
+	}
+
+	std::vector<double> all;
+	for (const std::vector<double> &list : latencies) {
+		all.insert(all.end(), list.begin(), list.end());
+	}
+	if (all.empty()) {
+		return true;
+	}
+	std::sort(all.begin(), all.end());
+	const auto percentile = [&all](double p) {
+		return all[std::min(all.size() - 1, size_t(p * all.size()))];
+	};
+
+	std::cout << all.size() << " requests over " << settings.connections << " connections, pipeline " << settings.pipeline
+		<< " in " << elapsed.count() << "s" << std::endl;
+	std::cout << "QPS: " << (all.size() / elapsed.count()) << std::endl;
+	std::cout << "Latency us: p50 " << percentile(0.5) << ", p90 " << percentile(0.9) << ", p99 " << percentile(0.99)
+		<< ", p99.9 " << percentile(0.999) << ", max " << all.back() << std::endl;
+	return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Automata.h"
+
+/// Settings for the query server and for the load generator connecting to it
+struct ServerSettings {
+	/// Address to listen on / connect to
+	std::string host = "127.0.0.1";
+	int port = 7878;
+	/// Number of worker threads of the server, each one polls the connections it accepted and serves the ready ones
+	int threads = 4;
+	/// Maximum number of completions returned for a prefix
+	int limit = 10;
+	/// A connection sending a longer request line is closed
+	int maxLineLength = 4096;
+	/// No more requests are read from a connection while it has this many response bytes not sent yet
+	int maxPendingOutput = 1 << 20;
+
+	/// Number of concurrent connections of the load generator
+	int connections = 4;
+	/// Total number of requests sent by the load generator
+	int requests = 200000;
+	/// Number of requests the load generator sends at once before reading the responses
+	int pipeline = 16;
+};
+
+/// Get the automata to answer a batch of requests with, the result is kept only until the batch is answered
+typedef std::function<std::shared_ptr<const Automata>()> AutomataProvider;
+
+/// Serve prefix queries over TCP until the process is stopped
+/// Protocol: each request is a line with the prefix, the response is a line with the number of completions
+/// followed by one line for each completion. All requests read at once from a connection are answered together.
+/// @param provider - called for each batch of requests, so the automata can be replaced while serving
+/// @param settings - address, worker threads and result limit
+/// @return false if the server failed to start
+bool runServer(const AutomataProvider &provider, const ServerSettings &settings);
+
+/// Serve prefix queries from a single automata, see runServer above
+/// @param dict - the automata to query, must not change while serving
+bool runServer(const Automata &dict, const ServerSettings &settings);
+
+/// Connect to a running server, send random prefixes of some words and print the QPS and latency percentiles
+/// @param words - the words to take prefixes from
+/// @param settings - address, connections, requests and pipeline depth
+/// @return false if it failed to connect or the connection was dropped
+bool runLoadGenerator(const Automata::WordList &words, const ServerSettings &settings);
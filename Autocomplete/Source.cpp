@@ -1,9 +1,127 @@
 #include "Automata.h"
+#include "AutomataReloader.h"
+#include "AutomataReplicas.h"
+#include "AutomataUnion.h"
+#include "Server.h"
+#include "SuccinctAutomata.h"
 
 #include <chrono>
+#include <cstring>
+#include <functional>
+#include <limits>
 #include <sstream>
 #include <memory>
+#include <random>
+#include <regex>
+#include <thread>
 
+#ifdef _WIN32
+#include <malloc.h>
+#define allocationSize _msize
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#define allocationSize malloc_size
+#else
+#include <malloc.h>
+#define allocationSize malloc_usable_size
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/// Counters of the global operator new, only updated while tracking is set so other benchmarks are not slowed down
+/// The replacements below cover every non aligned form of new and delete, the aligned ones of C++17 keep their
+/// default implementations, which do not call these, so they are not counted
+namespace allocations
+{
+std::atomic<bool> tracking{false};
+std::atomic<int64_t> count{0};
+std::atomic<int64_t> bytes{0};
+std::atomic<int64_t> peak{0};
+
+/// Start counting from zero
+void start() {
+	count = 0;
+	bytes = 0;
+	peak = 0;
+	tracking = true;
+}
+
+void stop() {
+	tracking = false;
+}
+
+/// Allocate and count the memory while tracking
+/// @return the memory or nullptr if there is not enough memory
+void *allocate(size_t size) noexcept {
+	void *memory = malloc(size ? size : 1);
+	if (memory && tracking.load(std::memory_order_relaxed)) {
+		count.fetch_add(1, std::memory_order_relaxed);
+		const int64_t usable = int64_t(allocationSize(memory));
+		const int64_t total = bytes.fetch_add(usable, std::memory_order_relaxed) + usable;
+		int64_t highest = peak.load(std::memory_order_relaxed);
+		while (total > highest && !peak.compare_exchange_weak(highest, total, std::memory_order_relaxed)) {
+		}
+	}
+	return memory;
+}
+
+void release(void *memory) noexcept {
+	// memory allocated before tracking started is also subtracted, so bytes can go below zero
+	if (memory && tracking.load(std::memory_order_relaxed)) {
+		bytes.fetch_sub(int64_t(allocationSize(memory)), std::memory_order_relaxed);
+	}
+	free(memory);
+}
+}
+
+void *operator new(size_t size) {
+	void *memory = allocations::allocate(size);
+	if (!memory) {
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void *operator new[](size_t size) {
+	return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+	return allocations::allocate(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+	return allocations::allocate(size);
+}
+
+void operator delete(void *memory) noexcept {
+	allocations::release(memory);
+}
+
+void operator delete[](void *memory) noexcept {
+	allocations::release(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept {
+	allocations::release(memory);
+}
+
+void operator delete[](void *memory, size_t) noexcept {
+	allocations::release(memory);
+}
+
+void operator delete(void *memory, const std::nothrow_t &) noexcept {
+	allocations::release(memory);
+}
+
+void operator delete[](void *memory, const std::nothrow_t &) noexcept {
+	allocations::release(memory);
+}
 
 typedef std::shared_ptr<std::istream> FilePtr;
 struct FileWithPath {
@@ -63,14 +181,900 @@ struct timer {
 	}
 };
 
+/// Build an automata specialized for an alphabet and time the build and a lookup of all prefixes of all words
+/// @param name - name of the alphabet to print
+/// @param words - the word list
+/// @param repeat - how many times to build the automata
+template <typename Alphabet>
+void timeAlphabet(const char *name, const Automata::WordList &words, int repeat) {
+	timer::ms_t::rep buildTotal = 0;
+	timer::ms_t::rep lookupTotal = 0;
+	int states = 0;
+	int skipped = 0;
+	int found = 0;
+	for (int c = 0; c < repeat; c++) {
+		BasicAutomata<Alphabet> dict;
+		{
+			timer t("");
+			dict.buildFromWordList(words);
+			buildTotal += t.getElapsed();
+		}
+		states = dict.getNumberOfStates();
+		skipped = dict.getNumberOfSkippedWords();
+
+		timer t("");
+		std::string prefix;
+		found = 0;
+		for (const std::string &word : words) {
+			for (int r = 1; r <= int(word.size()); r++) {
+				prefix.assign(word, 0, r);
+				found += dict.hasPrefix(prefix);
+			}
+		}
+		lookupTotal += t.getElapsed();
+	}
+	std::cout << "  " << name << ": states " << states << ", skipped words " << skipped
+		<< ", build " << (buildTotal / double(repeat)) << "ms"
+		<< ", lookup of " << found << " prefixes " << (lookupTotal / double(repeat)) << "ms" << std::endl;
+}
+
+/// Time looking up random prefixes of the words in an automata specialized for an alphabet, with and without path compression
+/// @param name - name of the alphabet to print
+/// @param words - the word list
+/// @param count - the number of random prefixes to look up
+template <typename Alphabet>
+void timeLookup(const char *name, const Automata::WordList &words, int count) {
+	typedef BasicAutomata<Alphabet> Dict;
+	Dict uncompressed;
+	uncompressed.buildFromWordList(words);
+	Dict dict;
+	dict.setPathCompression(true);
+	dict.buildFromWordList(words);
+	if (dict.getNumberOfWords() == 0) {
+		return;
+	}
+
+	std::mt19937 rng(42);
+	Automata::WordList prefixes(count);
+	for (std::string &prefix : prefixes) {
+		const std::string &word = dict.getWord(rng() % dict.getNumberOfWords());
+		prefix = word.empty() ? word : word.substr(0, 1 + rng() % word.size());
+	}
+
+	// both must find the same state for every prefix, also for prefixes that leave a chain early
+	int mismatches = 0;
+	for (const std::string &prefix : prefixes) {
+		std::string changed = prefix;
+		if (!changed.empty()) {
+			changed.back() ^= 1;
+		}
+		mismatches += dict.countSuffixes(prefix) != uncompressed.countSuffixes(prefix);
+		mismatches += dict.countSuffixes(changed) != uncompressed.countSuffixes(changed);
+	}
+
+	int found = 0;
+	const auto timeDict = [&prefixes, &found](const Dict &tested) {
+		found = 0;
+		const auto start = timer::clock_t::now();
+		for (const std::string &prefix : prefixes) {
+			found += tested.hasPrefix(prefix);
+		}
+		const std::chrono::duration<double, std::nano> elapsed = timer::clock_t::now() - start;
+		return elapsed.count() / prefixes.size();
+	};
+	// interleaved and the best of a few rounds, so both are measured in the same conditions
+	double uncompressedTime = 1e9, compressedTime = 1e9;
+	for (int c = 0; c < 3; c++) {
+		uncompressedTime = std::min(uncompressedTime, timeDict(uncompressed));
+		compressedTime = std::min(compressedTime, timeDict(dict));
+	}
+
+	std::cout << "  " << name << ": " << uncompressedTime << "ns per prefix, path compressed " << compressedTime
+		<< "ns, found " << found << "/" << count << ", mismatches " << mismatches
+		<< ", states " << dict.getNumberOfStates() << " -> " << dict.getNumberOfCompressedStates()
+		<< ", edges " << dict.getNumberOfEdges() << " -> " << dict.getNumberOfCompressedEdges()
+		<< ", states linear/simd16/simd32/bitmap/chain "
+		<< dict.getNumberOfStatesWithShape(Dict::SHAPE_LINEAR) << "/"
+		<< dict.getNumberOfStatesWithShape(Dict::SHAPE_SIMD16) << "/"
+		<< dict.getNumberOfStatesWithShape(Dict::SHAPE_SIMD32) << "/"
+		<< dict.getNumberOfStatesWithShape(Dict::SHAPE_BITMAP) << "/"
+		<< dict.getNumberOfStatesWithShape(Dict::SHAPE_CHAIN) << std::endl;
+}
+
+/// Compare the size and build time of the automata with and without the infix index
+/// @param words - the word list
+void timeInfix(const Automata::WordList &words) {
+	Automata prefixOnly;
+	timer::ms_t::rep prefixTime = 0;
+	{
+		timer t("");
+		prefixOnly.buildFromWordList(words);
+		prefixTime = t.getElapsed();
+	}
+
+	Automata dict;
+	dict.setInfixIndex(true);
+	timer::ms_t::rep infixTime = 0;
+	{
+		timer t("");
+		dict.buildFromWordList(words);
+		infixTime = t.getElapsed();
+	}
+	const Automata *infix = dict.getInfixIndex();
+
+	const double mb = 1024 * 1024;
+	std::cout << "  prefix index: states " << prefixOnly.getNumberOfStates() << ", edges " << prefixOnly.getNumberOfEdges()
+		<< ", memory " << (prefixOnly.getMemoryUsage() / mb) << "MB, build " << prefixTime << "ms" << std::endl;
+	std::cout << "  with infix index: suffixes " << infix->getNumberOfWords() << ", states " << infix->getNumberOfStates()
+		<< ", edges " << infix->getNumberOfEdges() << ", memory " << (dict.getMemoryUsage() / mb) << "MB, build " << infixTime << "ms" << std::endl;
+
+	const char *queries[] = {"ing", "tion", "qu", "zz", "ing"};
+	for (const char *query : queries) {
+		Automata::WordList matches;
+		const auto start = timer::clock_t::now();
+		dict.getWordsContaining(query, matches, 100);
+		const std::chrono::duration<double, std::micro> elapsed = timer::clock_t::now() - start;
+		std::cout << "  *" << query << "*: " << matches.size() << " words (limit 100) in " << elapsed.count() << "us" << std::endl;
+	}
+}
+
+/// Time queries skewed to short prefixes with different completion cache settings
+/// @param words - the word list
+/// @param count - the number of queries
+void timeCache(const Automata::WordList &words, int count) {
+	Automata dict;
+	dict.buildFromWordList(words);
+	if (dict.getNumberOfWords() == 0) {
+		return;
+	}
+
+	// 80% of the queries are 1-3 symbols long
+	std::mt19937 rng(42);
+	Automata::WordList prefixes(count);
+	for (std::string &prefix : prefixes) {
+		const std::string &word = dict.getWord(rng() % dict.getNumberOfWords());
+		const int length = rng() % 10 < 8 ? 1 + rng() % 3 : 1 + rng() % std::max<int>(1, word.size());
+		prefix = word.substr(0, length);
+	}
+
+	const int limit = 10;
+	const auto run = [&](const char *name, const Automata::CacheSettings &settings) {
+		dict.setCacheSettings(settings);
+		Automata::WordList suffixes;
+		const auto start = timer::clock_t::now();
+		for (const std::string &prefix : prefixes) {
+			suffixes.clear();
+			dict.getSuffixes(prefix, suffixes, limit);
+		}
+		const std::chrono::duration<double, std::nano> elapsed = timer::clock_t::now() - start;
+		std::cout << "  " << name << ": " << (elapsed.count() / count) << "ns per query, hits " << dict.getCacheHits()
+			<< ", misses " << dict.getCacheMisses() << ", cached states " << dict.getNumberOfCachedStates()
+			<< ", cache " << (dict.getCacheMemoryUsage() / 1024) << "KB" << std::endl;
+	};
+
+	Automata::CacheSettings settings;
+	run("no cache", settings);
+
+	settings.completions = limit;
+	settings.prefillDepth = 3;
+	run("prefill depth 3", settings);
+
+	settings.prefillDepth = 0;
+	settings.adaptive = true;
+	run("adaptive", settings);
+}
+
+/// Hardware counter of the data TLB misses of the calling thread, in user space only
+/// Only available on Linux and when perf_event_paranoid allows it, the count is -1 otherwise
+struct TlbMissCounter {
+	TlbMissCounter() {
+#ifdef __linux__
+		perf_event_attr attributes;
+		memset(&attributes, 0, sizeof(attributes));
+		attributes.type = PERF_TYPE_HW_CACHE;
+		attributes.size = sizeof(attributes);
+		attributes.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		attributes.disabled = 1;
+		attributes.exclude_kernel = 1;
+		attributes.exclude_hv = 1;
+		descriptor = int(syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0));
+#endif
+	}
+
+	~TlbMissCounter() {
+#ifdef __linux__
+		if (descriptor >= 0) {
+			close(descriptor);
+		}
+#endif
+	}
+
+	void start() {
+#ifdef __linux__
+		if (descriptor >= 0) {
+			ioctl(descriptor, PERF_EVENT_IOC_RESET, 0);
+			ioctl(descriptor, PERF_EVENT_IOC_ENABLE, 0);
+		}
+#endif
+	}
+
+	/// Stop counting
+	/// @return the misses since start or -1 if the counter is not available
+	int64_t stop() {
+#ifdef __linux__
+		uint64_t count = 0;
+		if (descriptor >= 0 && ioctl(descriptor, PERF_EVENT_IOC_DISABLE, 0) == 0 && read(descriptor, &count, sizeof(count)) == sizeof(count)) {
+			return int64_t(count);
+		}
+#endif
+		return -1;
+	}
+
+private:
+	int descriptor = -1;
+};
+
+/// Get the kilobytes of anonymous memory of the process in transparent huge pages, -1 if not known
+int64_t getAnonHugePagesKB() {
+	std::ifstream file("/proc/self/smaps_rollup");
+	std::string line;
+	while (getline(file, line)) {
+		if (!line.compare(0, 15, "AnonHugePages: ")) {
+			return atoll(line.c_str() + 15);
+		}
+	}
+	return -1;
+}
+
+/// Compare query latency and TLB misses of the automata with the frozen arrays in regular and in huge pages
+/// @param words - the word list
+/// @param count - the number of random prefixes to query
+void timeHugePages(Automata::WordList &words, int count) {
+	const int64_t hugeBefore = getAnonHugePagesKB();
+	Automata regular, huge;
+	huge.setHugePages(true);
+	regular.buildFromWordList(words);
+	huge.buildFromWordList(words);
+	const int64_t hugeAfter = getAnonHugePagesKB();
+	if (regular.getNumberOfWords() == 0) {
+		return;
+	}
+
+	AutomataReplicas replicas;
+	replicas.build(words, true);
+
+	std::mt19937 rng(42);
+	Automata::WordList prefixes(count);
+	for (std::string &prefix : prefixes) {
+		const std::string &word = regular.getWord(rng() % regular.getNumberOfWords());
+		prefix = word.substr(0, 1 + rng() % std::max<size_t>(1, word.size()));
+	}
+
+	TlbMissCounter counter;
+	Automata::WordList suffixes;
+	const auto run = [&prefixes, &counter, &suffixes](const std::function<const Automata &()> &dict, int64_t &misses) {
+		counter.start();
+		const auto start = timer::clock_t::now();
+		for (const std::string &prefix : prefixes) {
+			suffixes.clear();
+			dict().getSuffixes(prefix, suffixes, 10);
+		}
+		const std::chrono::duration<double, std::nano> elapsed = timer::clock_t::now() - start;
+		misses = counter.stop();
+		return elapsed.count() / prefixes.size();
+	};
+
+	// interleaved so that both see the same noise, the best run of each is kept
+	double times[3] = {1e30, 1e30, 1e30};
+	int64_t misses[3] = {-1, -1, -1};
+	for (int c = 0; c < 3; c++) {
+		int64_t runMisses[3] = {};
+		const double runTimes[3] = {
+			run([&regular]() -> const Automata & { return regular; }, runMisses[0]),
+			run([&huge]() -> const Automata & { return huge; }, runMisses[1]),
+			run([&replicas]() -> const Automata & { return *replicas.get(); }, runMisses[2]),
+		};
+		for (int r = 0; r < 3; r++) {
+			if (runTimes[r] < times[r]) {
+				times[r] = runTimes[r];
+				misses[r] = runMisses[r];
+			}
+		}
+	}
+
+	std::cout << "  frozen arrays " << regular.getMemoryUsage() / 1024 << "KB, in huge page mappings " << huge.getHugePageBytes() / 1024
+		<< "KB, AnonHugePages +" << (hugeAfter - hugeBefore) << "KB" << std::endl;
+	const char *names[3] = {"regular pages", "huge pages", "replicas"};
+	for (int c = 0; c < 3; c++) {
+		std::cout << "  " << names[c] << ": 10 suffixes " << times[c] << "ns, dTLB load misses " << misses[c];
+		if (misses[c] >= 0) {
+			std::cout << " (" << double(misses[c]) / prefixes.size() << " per query)";
+		}
+		std::cout << std::endl;
+	}
+	std::cout << "  " << replicas.getNumberOfReplicas() << " NUMA replicas, this thread is on node " << AutomataReplicas::getCurrentNode() << std::endl;
+}
+
+/// Check countSuffixes, rank and select against getSuffixes and the word list and time them
+/// @param words - the word list
+/// @param count - the number of random prefixes to query
+void timeCount(Automata::WordList &words, int count) {
+	Automata dict;
+	dict.buildFromWordList(std::move(words));
+	if (dict.getNumberOfWords() == 0) {
+		return;
+	}
+	const int firstWord = dict.getWord(0).empty() ? 1 : 0;
+
+	std::mt19937 rng(42);
+	Automata::WordList prefixes(count);
+	for (std::string &prefix : prefixes) {
+		const std::string &word = dict.getWord(rng() % dict.getNumberOfWords());
+		prefix = word.substr(0, 1 + rng() % std::max<size_t>(1, word.size() / 2));
+	}
+
+	int mismatches = 0;
+	for (int c = firstWord; c < dict.getNumberOfWords(); c++) {
+		mismatches += dict.rank(dict.getWord(c)) != c - firstWord;
+	}
+	Automata::WordList suffixes;
+	for (int c = 0; c < std::min(count, 10000); c++) {
+		const std::string &prefix = prefixes[c];
+		suffixes.clear();
+		dict.getSuffixes(prefix, suffixes);
+		mismatches += dict.countSuffixes(prefix) != int(suffixes.size());
+		if (!suffixes.empty()) {
+			const int index = int(rng() % suffixes.size());
+			mismatches += dict.getWord(dict.select(prefix, index)) != prefix + suffixes[index];
+		}
+		mismatches += dict.select(prefix, int(suffixes.size())) != -1;
+	}
+
+	const auto timeQueries = [&prefixes](const std::function<int64_t(const std::string &)> &query, int64_t &allocated) {
+		int64_t total = 0;
+		allocations::start();
+		const auto start = timer::clock_t::now();
+		for (const std::string &prefix : prefixes) {
+			total += query(prefix);
+		}
+		const std::chrono::duration<double, std::nano> elapsed = timer::clock_t::now() - start;
+		allocations::stop();
+		allocated = allocations::count;
+		return std::make_pair(elapsed.count() / prefixes.size(), total);
+	};
+	int64_t allocated[4] = {};
+	const auto enumerated = timeQueries([&dict, &suffixes](const std::string &prefix) {
+		suffixes.clear();
+		dict.getSuffixes(prefix, suffixes);
+		return int64_t(suffixes.size());
+	}, allocated[0]);
+	const auto counted = timeQueries([&dict](const std::string &prefix) { return int64_t(dict.countSuffixes(prefix)); }, allocated[1]);
+	const auto ranked = timeQueries([&dict](const std::string &prefix) { return int64_t(dict.rank(prefix)); }, allocated[2]);
+	const auto selected = timeQueries([&dict](const std::string &prefix) { return int64_t(dict.select(prefix, 0)); }, allocated[3]);
+
+	std::cout << "  getSuffixes().size(): " << enumerated.first << "ns, " << allocated[0] << " allocations" << std::endl;
+	std::cout << "  countSuffixes: " << counted.first << "ns, " << allocated[1] << " allocations, "
+		<< (counted.second == enumerated.second ? "same total" : "TOTALS DIFFER") << std::endl;
+	std::cout << "  rank: " << ranked.first << "ns, " << allocated[2] << " allocations" << std::endl;
+	std::cout << "  select: " << selected.first << "ns, " << allocated[3] << " allocations" << std::endl;
+	std::cout << "  mismatches " << mismatches << std::endl;
+}
+
+/// Page through the suffixes of random prefixes, check the pages against getSuffixes and time them
+/// @param words - the word list
+/// @param count - the number of random prefixes to query
+/// @param pageSize - the number of suffixes in a page
+void timePaging(Automata::WordList &words, int count, int pageSize) {
+	Automata dict;
+	dict.buildFromWordList(std::move(words));
+	if (dict.getNumberOfWords() == 0) {
+		return;
+	}
+
+	std::mt19937 rng(42);
+	Automata::WordList prefixes(count);
+	for (std::string &prefix : prefixes) {
+		const std::string &word = dict.getWord(rng() % dict.getNumberOfWords());
+		prefix = word.substr(0, 1 + rng() % std::max<size_t>(1, word.size() / 2));
+	}
+
+	// every page continues after the last suffix of the previous one, together they must be all suffixes in order
+	int mismatches = 0;
+	Automata::WordList all, paged, page;
+	for (int c = 0; c < std::min(count, 1000); c++) {
+		all.clear();
+		paged.clear();
+		dict.getSuffixes(prefixes[c], all);
+		page.clear();
+		dict.getSuffixes(prefixes[c], page, pageSize);
+		while (!page.empty()) {
+			paged.insert(paged.end(), page.begin(), page.end());
+			const std::string after = page.back();
+			page.clear();
+			dict.getSuffixes(prefixes[c], page, pageSize, after);
+		}
+		mismatches += paged != all || !std::is_sorted(all.begin(), all.end(), [](const std::string &a, const std::string &b) {
+			return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(), [](char x, char y) {
+				return static_cast<unsigned char>(x) < static_cast<unsigned char>(y);
+			});
+		});
+	}
+
+	// the middle suffix of each prefix, the page after it is the worst case for a skip over the range
+	Automata::WordList middles(count);
+	for (int c = 0; c < count; c++) {
+		const int words = dict.countSuffixes(prefixes[c]);
+		const int index = dict.select(prefixes[c], words / 2);
+		if (index >= 0) {
+			middles[c] = dict.getWord(index).substr(prefixes[c].size());
+		}
+	}
+
+	const auto timeQueries = [&prefixes](const std::function<void(int)> &query) {
+		const auto start = timer::clock_t::now();
+		for (int c = 0; c < int(prefixes.size()); c++) {
+			query(c);
+		}
+		const std::chrono::duration<double, std::nano> elapsed = timer::clock_t::now() - start;
+		return elapsed.count() / prefixes.size();
+	};
+	Automata::WordList suffixes;
+	const double full = timeQueries([&dict, &prefixes, &suffixes](int c) {
+		suffixes.clear();
+		dict.getSuffixes(prefixes[c], suffixes);
+	});
+	const double first = timeQueries([&dict, &prefixes, &suffixes, pageSize](int c) {
+		suffixes.clear();
+		dict.getSuffixes(prefixes[c], suffixes, pageSize);
+	});
+	const double middle = timeQueries([&dict, &prefixes, &middles, &suffixes, pageSize](int c) {
+		suffixes.clear();
+		dict.getSuffixes(prefixes[c], suffixes, pageSize, middles[c]);
+	});
+
+	std::cout << "  all suffixes: " << full << "ns, first page of " << pageSize << ": " << first << "ns, page after the middle: "
+		<< middle << "ns" << std::endl;
+	std::cout << "  mismatches " << mismatches << std::endl;
+}
+
+/// Build with each hash strategy and report the build time and the registry diagnostics
+/// @param words - the word list
+/// @param repeat - the number of builds to time for each strategy, without diagnostics
+void timeHash(const Automata::WordList &words, int repeat) {
+	const std::pair<const char *, Automata::HashStrategy> strategies[] = {
+		{"xor", Automata::HASH_XOR},
+		{"sum", Automata::HASH_SUM},
+		{"sort", Automata::HASH_SORT},
+	};
+	for (const auto &strategy : strategies) {
+		timer::ms_t::rep best = std::numeric_limits<timer::ms_t::rep>::max();
+		for (int c = 0; c < repeat; c++) {
+			Automata dict;
+			dict.setHashStrategy(strategy.second);
+			timer t("");
+			dict.buildFromWordList(words);
+			best = std::min(best, t.getElapsed());
+		}
+
+		Automata dict;
+		dict.setHashStrategy(strategy.second);
+		dict.setHashDiagnostics(true);
+		dict.buildFromWordList(words);
+		const Automata::HashStats &stats = dict.getHashStats();
+		std::cout << "  " << strategy.first << ": build " << best << "ms, comparisons " << stats.comparisons
+			<< ", equal hash " << stats.truePositives << " true / " << stats.falsePositives << " false"
+			<< ", slowEqual " << stats.slowEqualTime / 1000000 << "ms" << std::endl;
+		std::cout << "    registry " << stats.registrySize << " states in " << stats.buckets << " buckets, "
+			<< stats.sharedHashes << " with a shared hash, max bucket " << stats.maxBucketLoad << ", bucket loads";
+		for (size_t c = 0; c < stats.bucketLoads.size(); c++) {
+			std::cout << " " << c << (c + 1 == stats.bucketLoads.size() ? "+:" : ":") << stats.bucketLoads[c];
+		}
+		std::cout << std::endl;
+	}
+}
+
+/// Time getting all words of the automata on one thread and with getSuffixesParallel
+/// @param words - the word list
+void timeBulk(Automata::WordList &words) {
+	Automata dict;
+	dict.buildFromWordList(std::move(words));
+
+	const int repeat = 5;
+	Automata::WordList expected, actual;
+	double serialTime = 1e30;
+	for (int c = 0; c < repeat; c++) {
+		expected.clear();
+		expected.shrink_to_fit();
+		const auto start = timer::clock_t::now();
+		dict.getSuffixes("", expected);
+		const std::chrono::duration<double, std::milli> elapsed = timer::clock_t::now() - start;
+		serialTime = std::min(serialTime, elapsed.count());
+	}
+	std::cout << "  getSuffixes: " << expected.size() << " words " << serialTime << "ms" << std::endl;
+
+	const int hardware = std::max(1, int(std::thread::hardware_concurrency()));
+	for (int threads = 1; threads <= std::max(8, hardware); threads *= 2) {
+		double best = 1e30;
+		for (int c = 0; c < repeat; c++) {
+			actual.clear();
+			actual.shrink_to_fit();
+			const auto start = timer::clock_t::now();
+			dict.getSuffixesParallel("", actual, threads);
+			const std::chrono::duration<double, std::milli> elapsed = timer::clock_t::now() - start;
+			best = std::min(best, elapsed.count());
+		}
+		std::cout << "  getSuffixesParallel " << threads << " threads: " << best << "ms, speedup " << serialTime / best
+			<< (actual == expected ? "" : ", RESULTS DIFFER") << std::endl;
+	}
+}
+
+/// Count the allocations and the peak memory allocated while building the automata
+/// @param words - the word list, copied before counting starts
+void timeMemory(const Automata::WordList &words) {
+	Automata::WordList copy = words;
+	Automata dict;
+	timer::ms_t::rep elapsed = 0;
+	allocations::start();
+	{
+		timer t("");
+		dict.buildFromWordList(std::move(copy));
+		elapsed = t.getElapsed();
+	}
+	allocations::stop();
+	std::cout << "  build " << elapsed << "ms, " << allocations::count << " allocations, peak " << allocations::peak / 1024
+		<< "KB, after the build " << allocations::bytes / 1024 << "KB, automata " << dict.getMemoryUsage() / 1024 << "KB" << std::endl;
+}
+
+/// Time writing the automata as graph-viz and as binary edge list
+/// @param words - the word list
+void timeGraphDump(Automata::WordList &words) {
+	Automata dict;
+	dict.buildFromWordList(std::move(words));
+
+	const auto dump = [&dict](const char *name, const char *path, GraphDump *graphDump) {
+		timer::ms_t::rep elapsed = 0;
+		{
+			timer t("");
+			dict.dumpGraph(graphDump);
+			elapsed = t.getElapsed();
+		}
+		std::ifstream written(path, std::ios::binary | std::ios::ate);
+		std::cout << "  " << name << ": " << elapsed << "ms, " << (written.tellg() / 1024) << "KB for "
+			<< dict.getNumberOfStates() << " states and " << dict.getNumberOfEdges() << " edges" << std::endl;
+	};
+	dump("graph-viz", "viz.dot", dict.getDefaultGraphDump("viz.dot"));
+	dump("binary", "viz.bin", dict.getBinaryGraphDump("viz.bin"));
+}
+
+/// Compare the memory, lookup and enumeration time of the frozen automata and its succinct copy
+/// @param words - the word list
+/// @param count - the number of random prefixes to look up
+void timeSuccinct(Automata::WordList &words, int count) {
+	Automata dict;
+	dict.buildFromWordList(std::move(words));
+	if (dict.getNumberOfWords() == 0) {
+		return;
+	}
+
+	SuccinctAutomata succinct;
+	timer::ms_t::rep buildTime = 0;
+	{
+		timer t("");
+		succinct.build(dict);
+		buildTime = t.getElapsed();
+	}
+
+	std::mt19937 rng(42);
+	Automata::WordList prefixes(count);
+	for (std::string &prefix : prefixes) {
+		const std::string &word = dict.getWord(rng() % dict.getNumberOfWords());
+		prefix = word.empty() ? word : word.substr(0, 1 + rng() % word.size());
+	}
+
+	// both must return the same suffixes in the same order
+	int mismatches = 0;
+	Automata::WordList expected, actual;
+	for (int c = 0; c < count; c += 100) {
+		expected.clear();
+		actual.clear();
+		dict.getSuffixes(prefixes[c], expected, 10);
+		succinct.getSuffixes(prefixes[c], actual, 10);
+		mismatches += expected != actual;
+	}
+
+	const auto timeQueries = [&prefixes](const std::function<void(const std::string &)> &query) {
+		const auto start = timer::clock_t::now();
+		for (const std::string &prefix : prefixes) {
+			query(prefix);
+		}
+		const std::chrono::duration<double, std::nano> elapsed = timer::clock_t::now() - start;
+		return elapsed.count() / prefixes.size();
+	};
+	int found = 0;
+	const double frozenLookup = timeQueries([&dict, &found](const std::string &prefix) { found += dict.hasPrefix(prefix); });
+	const double succinctLookup = timeQueries([&succinct, &found](const std::string &prefix) { found += succinct.hasPrefix(prefix); });
+	const double frozenSuffixes = timeQueries([&dict, &actual](const std::string &prefix) {
+		actual.clear();
+		dict.getSuffixes(prefix, actual, 10);
+	});
+	const double succinctSuffixes = timeQueries([&succinct, &actual](const std::string &prefix) {
+		actual.clear();
+		succinct.getSuffixes(prefix, actual, 10);
+	});
+
+	std::cout << "  states " << succinct.getNumberOfStates() << ", edges " << succinct.getNumberOfEdges()
+		<< ", words " << succinct.countWords("") << ", built in " << buildTime << "ms" << std::endl;
+	std::cout << "  frozen: " << dict.getMemoryUsage() / 1024 << "KB, lookup " << frozenLookup << "ns, 10 suffixes " << frozenSuffixes << "ns" << std::endl;
+	std::cout << "  succinct: " << succinct.getMemoryUsage() / 1024 << "KB, lookup " << succinctLookup << "ns, 10 suffixes " << succinctSuffixes
+		<< "ns, mismatches " << mismatches << std::endl;
+}
+
+/// Convert a glob pattern to the same regular expression, used to check BasicAutomata::match
+std::string globToRegex(const std::string &pattern) {
+	std::string regex;
+	for (size_t c = 0; c < pattern.size(); c++) {
+		const char value = pattern[c];
+		if (value == '*') {
+			regex += ".*";
+		} else if (value == '?') {
+			regex += '.';
+		} else if (value == '[') {
+			const size_t end = pattern.find(']', c + 2);
+			std::string set = pattern.substr(c + 1, end - c - 1);
+			if (set[0] == '!') {
+				set[0] = '^';
+			}
+			regex += '[' + set + ']';
+			c = end;
+		} else {
+			if (value == '\\' && c + 1 < pattern.size()) {
+				++c;
+			}
+			if (!isalnum(static_cast<unsigned char>(pattern[c]))) {
+				regex += '\\';
+			}
+			regex += pattern[c];
+		}
+	}
+	return regex;
+}
+
+/// Time matching glob patterns against the automata compared to a regular expression over the word list
+/// @param words - the word list
+void timeMatch(Automata::WordList &words) {
+	Automata dict;
+	dict.buildFromWordList(words);
+
+	const char *patterns[] = {"te?t*", "[a-c]at", "*ing", "????", "s*t*n", "[!a-z]*", "*q[!u]*", "*"};
+	for (const char *pattern : patterns) {
+		int matched = 0;
+		timer::ms_t::rep matchTime = 0;
+		{
+			timer t("");
+			dict.match(pattern, [&matched](const std::string &) { ++matched; }, INT_MAX);
+			matchTime = t.getElapsed();
+		}
+
+		int expected = 0;
+		timer::ms_t::rep regexTime = 0;
+		{
+			timer t("");
+			const std::regex regex(globToRegex(pattern));
+			for (int c = 0; c < dict.getNumberOfWords(); c++) {
+				const std::string &word = dict.getWord(c);
+				expected += !word.empty() && std::regex_match(word, regex);
+			}
+			regexTime = t.getElapsed();
+		}
+		std::cout << "  " << pattern << ": " << matched << " words in " << matchTime << "ms, regex over the word list "
+			<< expected << " words in " << regexTime << "ms" << std::endl;
+	}
+}
+
+/// Compare a union of a shared base dictionary and a small one with an automata built from both word lists
+/// @param words - the word list of the base dictionary
+/// @param count - the number of random prefixes to query
+void timeUnion(Automata::WordList &words, int count) {
+	if (words.empty()) {
+		return;
+	}
+
+	// the small dictionary has some of the base words and some new ones made from them
+	std::mt19937 rng(42);
+	Automata::WordList tenantWords;
+	for (int c = 0; c < 2000; c++) {
+		const std::string &word = words[rng() % words.size()];
+		tenantWords.push_back(c % 2 ? word : word + "-" + std::to_string(c));
+	}
+	Automata::WordList allWords = words;
+	allWords.insert(allWords.end(), tenantWords.begin(), tenantWords.end());
+
+	std::shared_ptr<Automata> base(new Automata);
+	base->buildFromWordList(words);
+	Automata combined;
+	timer::ms_t::rep combinedTime = 0;
+	{
+		timer t("");
+		combined.buildFromWordList(allWords);
+		combinedTime = t.getElapsed();
+	}
+
+	Automata::WordList prefixes(count);
+	for (std::string &prefix : prefixes) {
+		const std::string &word = allWords[rng() % allWords.size()];
+		prefix = word.empty() ? word : word.substr(0, 1 + rng() % word.size());
+	}
+
+	Automata::WordList expected, actual;
+	const auto timeQueries = [&prefixes, &actual](const std::function<void(const std::string &)> &query) {
+		const auto start = timer::clock_t::now();
+		for (const std::string &prefix : prefixes) {
+			actual.clear();
+			query(prefix);
+		}
+		const std::chrono::duration<double, std::nano> elapsed = timer::clock_t::now() - start;
+		return elapsed.count() / prefixes.size();
+	};
+	const double combinedQuery = timeQueries([&combined, &actual](const std::string &prefix) { combined.getSuffixes(prefix, actual, 10); });
+	std::cout << "  combined: build " << combinedTime << "ms, " << combined.getMemoryUsage() / 1024 << "KB, 10 suffixes " << combinedQuery << "ns" << std::endl;
+
+	// the same extra words split between more dictionaries, the union stays the same
+	for (const int parts : {1, 8}) {
+		AutomataUnion dicts;
+		dicts.add(base);
+		size_t tenantBytes = 0;
+		timer::ms_t::rep tenantTime = 0;
+		for (int part = 0; part < parts; part++) {
+			Automata::WordList partWords(tenantWords.begin() + tenantWords.size() * part / parts, tenantWords.begin() + tenantWords.size() * (part + 1) / parts);
+			std::shared_ptr<Automata> tenant(new Automata);
+			timer t("");
+			tenant->buildFromWordList(partWords);
+			tenantTime += t.getElapsed();
+			tenantBytes += tenant->getMemoryUsage();
+			dicts.add(tenant);
+		}
+
+		int mismatches = 0;
+		for (const std::string &prefix : prefixes) {
+			expected.clear();
+			actual.clear();
+			combined.getSuffixes(prefix, expected, 10);
+			dicts.getSuffixes(prefix, actual, 10);
+			mismatches += expected != actual;
+		}
+
+		const double unionQuery = timeQueries([&dicts, &actual](const std::string &prefix) { dicts.getSuffixes(prefix, actual, 10); });
+		std::cout << "  union of " << dicts.size() << ": build " << tenantTime << "ms, " << tenantBytes / 1024 << "KB on top of the base, 10 suffixes "
+			<< unionQuery << "ns (" << unionQuery / combinedQuery << "x combined), mismatches " << mismatches << std::endl;
+	}
+}
+
+/// Query an automata that is rebuilt in the background while its word list changes and report the query stalls
+/// @param words - the word list, written to reload.txt which is changed while querying
+void timeReload(const Automata::WordList &words) {
+	if (words.empty()) {
+		return;
+	}
+	const char *path = "reload.txt";
+	const auto writeWords = [path, &words](int extra) {
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		for (const std::string &word : words) {
+			file << word << '\n';
+		}
+		for (int c = 0; c < extra; c++) {
+			file << words[c % words.size()] << "-reload" << c << '\n';
+		}
+	};
+	writeWords(0);
+
+	AutomataReloader reloader(path, 50);
+	if (!reloader.load()) {
+		return;
+	}
+	const int64_t blackout = reloader.getStats().buildTime;
+
+	std::mt19937 rng(42);
+	Automata::WordList prefixes(4096);
+	for (std::string &prefix : prefixes) {
+		const std::string &word = words[rng() % words.size()];
+		prefix = word.substr(0, 1 + rng() % std::max<size_t>(1, word.size()));
+	}
+
+	// phase 0 is before the file changes, phase 1 until the new automata is in place and phase 2 after it
+	struct PhaseStats {
+		int64_t queries = 0;
+		double total = 0;
+		double worst = 0;
+	};
+	PhaseStats phases[3];
+	std::atomic<int> phase{0};
+	std::atomic<bool> done{false};
+	std::thread queries([&]() {
+		Automata::WordList suffixes;
+		for (size_t c = 0; !done; c++) {
+			const int current = phase;
+			const auto start = timer::clock_t::now();
+			suffixes.clear();
+			reloader.get()->getSuffixes(prefixes[c % prefixes.size()], suffixes, 10);
+			const std::chrono::duration<double, std::micro> elapsed = timer::clock_t::now() - start;
+			PhaseStats &stats = phases[current];
+			++stats.queries;
+			stats.total += elapsed.count();
+			stats.worst = std::max(stats.worst, elapsed.count());
+		}
+	});
+
+	std::mutex mutex;
+	std::condition_variable swapped;
+	reloader.setSwapCallback([&](const AutomataReloader::Stats &) {
+		std::lock_guard<std::mutex> lock(mutex);
+		phase = 2;
+		swapped.notify_all();
+	});
+	reloader.start();
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(500));
+	const auto changed = timer::clock_t::now();
+	phase = 1;
+	writeWords(1000);
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		swapped.wait(lock, [&phase] { return phase == 2; });
+	}
+	const std::chrono::duration<double, std::milli> reloadTime = timer::clock_t::now() - changed;
+	std::this_thread::sleep_for(std::chrono::milliseconds(500));
+	done = true;
+	queries.join();
+	reloader.stop();
+	std::remove(path);
+
+	const AutomataReloader::Stats stats = reloader.getStats();
+	std::cout << "  rebuild: read " << stats.readTime << "ms, build " << stats.buildTime << "ms, swap " << stats.swapTime
+		<< "ns, " << stats.words << " words, new automata in use " << reloadTime.count() << "ms after the change"
+		<< " (blocking build " << blackout << "ms)" << std::endl;
+	const char *names[3] = {"before", "rebuilding", "after"};
+	for (int c = 0; c < 3; c++) {
+		const PhaseStats &stats = phases[c];
+		std::cout << "  queries " << names[c] << ": " << stats.queries << ", average " << (stats.queries ? stats.total / stats.queries : 0)
+			<< "us, worst " << stats.worst << "us" << std::endl;
+	}
+}
+
 const char *HELP_TEXT =
 "Autocomplete for a list of words separated by new line\n"
 "Arguments:\n"
 "--help		Display this help message and exit\n"
 #if !AC_ASSERT_ENABLED
 "--time		Use list of predefined files in ./lists to time the automata build time\n"
+"--alphabet	Compare automata specialized for the lowercase alphabet against the generic byte alphabet\n"
+"--lookup	Time the prefix lookup on random prefixes of the words, with and without path compression\n"
+"--infix		Report the size and build time of the infix index\n"
+"--cache		Time short prefix queries with and without the completion cache\n"
+"--graph		Time writing viz.dot and the binary edge list viz.bin\n"
+"--succinct	Compare memory and query time of the succinct copy of the automata\n"
+"--match		Time glob pattern queries compared to a regular expression over the word list\n"
+"--union		Compare a union of a base and a small dictionary with an automata built from both word lists\n"
+"--hugepages	Compare query time and TLB misses with the frozen arrays in huge pages and in NUMA replicas\n"
+"--count		Check and time countSuffixes, rank and select\n"
+"--page		Check and time paging through the suffixes with getSuffixes after a key\n"
+"--hash		Compare the build time and the registry stats of the hash strategies\n"
+"--bulk		Time getting all words with one thread and with several threads\n"
+"--memory	Count the allocations and the peak memory of the build\n"
+"--reload	Query while the word list changes and the automata is rebuilt in the background\n"
 #endif
-"--file [path]	Pass path to a file to load instead of the predefined one in subdir lists\n";
+"--verify	Build each file and check the automata against the word list\n"
+"--file [path]	Pass path to a file to load instead of the predefined one in subdir lists\n"
+"--server	Serve prefix queries over TCP for --file or lists/370k.txt, rebuilt when the file changes\n"
+"--client	Run load generator against a running server with prefixes from --file or lists/370k.txt\n"
+"--host [ip]	Address for --server and --client, default 127.0.0.1\n"
+"--port [n]	Port for --server and --client, default 7878\n"
+"--huge-pages	Place the frozen arrays of the server automata in huge pages\n"
+"--numa	Serve each batch from a copy of the automata on the NUMA node of the worker, the file is not reloaded\n"
+"--threads [n]	Worker threads of the server\n"
+"--limit [n]	Maximum number of completions the server returns for a prefix\n"
+"--connections [n]	Concurrent connections of the load generator\n"
+"--requests [n]	Total requests sent by the load generator\n"
+"--pipeline [n]	Requests the load generator sends before reading the responses\n";
 
 
 int main(int argc, char *argv[]) {
@@ -78,14 +1082,32 @@ int main(int argc, char *argv[]) {
 		"lists/1k.txt",
 		"lists/3k.txt",
 		"lists/58k.txt",
-#if !AC_ASSERT_ENABLED
-		// too slow for debug + assert
 		"lists/370k.txt",
-#endif
 		"lists/naughty.txt"
 	};
 
 	bool timeTest = true; // set to true to force time test
+	bool alphabetTest = false;
+	bool lookupTest = false;
+	bool infixTest = false;
+	bool cacheTest = false;
+	bool graphTest = false;
+	bool succinctTest = false;
+	bool matchTest = false;
+	bool unionTest = false;
+	bool reloadTest = false;
+	bool memoryTest = false;
+	bool bulkTest = false;
+	bool hashTest = false;
+	bool countTest = false;
+	bool pageTest = false;
+	bool hugePagesTest = false;
+	bool verifyTest = false;
+	bool serverMode = false;
+	bool serverHugePages = false;
+	bool serverReplicas = false;
+	bool clientMode = false;
+	ServerSettings serverSettings;
 	std::string overrideFile;
 
 	if (argc > 1) {
@@ -96,9 +1118,64 @@ int main(int argc, char *argv[]) {
 			if (!strcmp(param, "--file") && next) {
 				filePaths.clear();
 				filePaths.emplace_back(next);
+				overrideFile = next;
+			} else if (!strcmp(param, "--server")) {
+				serverMode = true;
+			} else if (!strcmp(param, "--huge-pages")) {
+				serverHugePages = true;
+			} else if (!strcmp(param, "--numa")) {
+				serverReplicas = true;
+			} else if (!strcmp(param, "--client")) {
+				clientMode = true;
+			} else if (!strcmp(param, "--host") && next) {
+				serverSettings.host = next;
+			} else if (!strcmp(param, "--port") && next) {
+				serverSettings.port = atoi(next);
+			} else if (!strcmp(param, "--threads") && next) {
+				serverSettings.threads = std::max(1, atoi(next));
+			} else if (!strcmp(param, "--limit") && next) {
+				serverSettings.limit = std::max(1, atoi(next));
+			} else if (!strcmp(param, "--connections") && next) {
+				serverSettings.connections = std::max(1, atoi(next));
+			} else if (!strcmp(param, "--requests") && next) {
+				serverSettings.requests = std::max(1, atoi(next));
+			} else if (!strcmp(param, "--pipeline") && next) {
+				serverSettings.pipeline = std::max(1, atoi(next));
+			} else if (!strcmp(param, "--verify")) {
+				verifyTest = true;
 #if !AC_ASSERT_ENABLED
 			} else if (!strcmp(param, "--time")) {
 				timeTest = true;
+			} else if (!strcmp(param, "--alphabet")) {
+				alphabetTest = true;
+			} else if (!strcmp(param, "--lookup")) {
+				lookupTest = true;
+			} else if (!strcmp(param, "--infix")) {
+				infixTest = true;
+			} else if (!strcmp(param, "--cache")) {
+				cacheTest = true;
+			} else if (!strcmp(param, "--graph")) {
+				graphTest = true;
+			} else if (!strcmp(param, "--succinct")) {
+				succinctTest = true;
+			} else if (!strcmp(param, "--match")) {
+				matchTest = true;
+			} else if (!strcmp(param, "--union")) {
+				unionTest = true;
+			} else if (!strcmp(param, "--reload")) {
+				reloadTest = true;
+			} else if (!strcmp(param, "--memory")) {
+				memoryTest = true;
+			} else if (!strcmp(param, "--bulk")) {
+				bulkTest = true;
+			} else if (!strcmp(param, "--hash")) {
+				hashTest = true;
+			} else if (!strcmp(param, "--count")) {
+				countTest = true;
+			} else if (!strcmp(param, "--page")) {
+				pageTest = true;
+			} else if (!strcmp(param, "--hugepages")) {
+				hugePagesTest = true;
 #endif
 			} else if (!strcmp(param, "--help")) {
 				std::cout << HELP_TEXT << std::endl;
@@ -107,6 +1184,50 @@ int main(int argc, char *argv[]) {
 		}
 	}
 
+	if (serverMode || clientMode) {
+		const std::string path = overrideFile.empty() ? "lists/370k.txt" : overrideFile;
+		if (clientMode) {
+			Automata::WordList words;
+			if (!readFileLines(FileWithPath(path, FilePtr(new std::ifstream(path))), words)) {
+				return 1;
+			}
+			return runLoadGenerator(words, serverSettings) ? 0 : 1;
+		}
+
+		if (serverReplicas) {
+			Automata::WordList words;
+			if (!readFileLines(FileWithPath(path, FilePtr(new std::ifstream(path))), words)) {
+				return 1;
+			}
+			AutomataReplicas replicas;
+			{
+				timer t("build " + std::to_string(AutomataReplicas::getNumberOfNodes()) + " replicas of " + path);
+				replicas.build(words, serverHugePages);
+			}
+			// the workers are not bound to a node, each batch takes the copy of the node the worker runs on at the time
+			return runServer([&replicas]() { return replicas.get(); }, serverSettings) ? 0 : 1;
+		}
+
+		AutomataReloader reloader(path);
+		if (serverHugePages) {
+			reloader.setPrepareCallback([](Automata &dict) {
+				dict.setHugePages(true);
+			});
+		}
+		{
+			timer t("build " + path);
+			if (!reloader.load()) {
+				return 1;
+			}
+		}
+		reloader.setSwapCallback([&path](const AutomataReloader::Stats &stats) {
+			std::cout << "Reloaded " << path << ": " << stats.words << " words, read " << stats.readTime << "ms, build "
+				<< stats.buildTime << "ms, swap " << stats.swapTime << "ns" << std::endl;
+		});
+		reloader.start();
+		return runServer([&reloader]() { return reloader.get(); }, serverSettings) ? 0 : 1;
+	}
+
 	std::vector<FileWithPath> files;
 
 	if (filePaths.size() > 1) {
@@ -126,6 +1247,215 @@ int main(int argc, char *argv[]) {
 		files.emplace_back(fpath, FilePtr(new std::ifstream(fpath)));
 	}
 
+	if (verifyTest) {
+		bool valid = true;
+		for (const FileWithPath &pair : files) {
+			Automata::WordList words;
+			if (!readFileLines(pair, words)) {
+				continue;
+			}
+			Automata dict;
+			{
+				timer t("build " + pair.path);
+				dict.buildFromWordList(std::move(words));
+			}
+			bool result = false;
+			{
+				timer t("verify " + pair.path);
+				result = dict.runVerify();
+			}
+			std::cout << pair.path << " states " << dict.getNumberOfStates() << ", verify: " << result << std::endl;
+			valid = valid && result;
+		}
+		return valid ? 0 : 1;
+	}
+
+#if !AC_ASSERT_ENABLED
+	if (alphabetTest) {
+		const int repeat = 10;
+		for (const FileWithPath &pair : files) {
+			Automata::WordList words;
+			if (!readFileLines(pair, words)) {
+				continue;
+			}
+			std::cout << pair.path << std::endl;
+			timeAlphabet<ByteAlphabet>("byte", words, repeat);
+			timeAlphabet<LowercaseAlphabet>("lowercase", words, repeat);
+		}
+		return 0;
+	}
+
+	if (lookupTest) {
+		const int count = 1000000;
+		for (const FileWithPath &pair : files) {
+			Automata::WordList words;
+			if (!readFileLines(pair, words)) {
+				continue;
+			}
+			std::cout << pair.path << std::endl;
+			timeLookup<ByteAlphabet>("byte", words, count);
+			timeLookup<LowercaseAlphabet>("lowercase", words, count);
+		}
+		return 0;
+	}
+
+	if (infixTest) {
+		for (const FileWithPath &pair : files) {
+			Automata::WordList words;
+			if (!readFileLines(pair, words)) {
+				continue;
+			}
+			std::cout << pair.path << std::endl;
+			timeInfix(words);
+		}
+		return 0;
+	}
+
+	if (cacheTest) {
+		for (const FileWithPath &pair : files) {
+			Automata::WordList words;
+			if (!readFileLines(pair, words)) {
+				continue;
+			}
+			std::cout << pair.path << std::endl;
+			timeCache(words, 1000000);
+		}
+		return 0;
+	}
+
+	if (graphTest) {
+		for (const FileWithPath &pair : files) {
+			Automata::WordList words;
+			if (!readFileLines(pair, words)) {
+				continue;
+			}
+			std::cout << pair.path << std::endl;
+			timeGraphDump(words);
+		}
+		return 0;
+	}
+
+	if (succinctTest) {
+		for (const FileWithPath &pair : files) {
+			Automata::WordList words;
+			if (!readFileLines(pair, words)) {
+				continue;
+			}
+			std::cout << pair.path << std::endl;
+			timeSuccinct(words, 1000000);
+		}
+		return 0;
+	}
+
+	if (matchTest) {
+		for (const FileWithPath &pair : files) {
+			Automata::WordList words;
+			if (!readFileLines(pair, words)) {
+				continue;
+			}
+			std::cout << pair.path << std::endl;
+			timeMatch(words);
+		}
+		return 0;
+	}
+
+	if (unionTest) {
+		for (const FileWithPath &pair : files) {
+			Automata::WordList words;
+			if (!readFileLines(pair, words)) {
+				continue;
+			}
+			std::cout << pair.path << std::endl;
+			timeUnion(words, 100000);
+		}
+		return 0;
+	}
+
+	if (hugePagesTest) {
+		for (const FileWithPath &pair : files) {
+			Automata::WordList words;
+			if (!readFileLines(pair, words)) {
+				continue;
+			}
+			std::cout << pair.path << std::endl;
+			timeHugePages(words, 1000000);
+		}
+		return 0;
+	}
+
+	if (pageTest) {
+		for (const FileWithPath &pair : files) {
+			Automata::WordList words;
+			if (!readFileLines(pair, words)) {
+				continue;
+			}
+			std::cout << pair.path << std::endl;
+			timePaging(words, 100000, 10);
+		}
+		return 0;
+	}
+
+	if (countTest) {
+		for (const FileWithPath &pair : files) {
+			Automata::WordList words;
+			if (!readFileLines(pair, words)) {
+				continue;
+			}
+			std::cout << pair.path << std::endl;
+			timeCount(words, 100000);
+		}
+		return 0;
+	}
+
+	if (hashTest) {
+		for (const FileWithPath &pair : files) {
+			Automata::WordList words;
+			if (!readFileLines(pair, words)) {
+				continue;
+			}
+			std::cout << pair.path << std::endl;
+			timeHash(words, 3);
+		}
+		return 0;
+	}
+
+	if (bulkTest) {
+		for (const FileWithPath &pair : files) {
+			Automata::WordList words;
+			if (!readFileLines(pair, words)) {
+				continue;
+			}
+			std::cout << pair.path << std::endl;
+			timeBulk(words);
+		}
+		return 0;
+	}
+
+	if (memoryTest) {
+		for (const FileWithPath &pair : files) {
+			Automata::WordList words;
+			if (!readFileLines(pair, words)) {
+				continue;
+			}
+			std::cout << pair.path << std::endl;
+			timeMemory(words);
+		}
+		return 0;
+	}
+
+	if (reloadTest) {
+		for (const FileWithPath &pair : files) {
+			Automata::WordList words;
+			if (!readFileLines(pair, words)) {
+				continue;
+			}
+			std::cout << pair.path << std::endl;
+			timeReload(words);
+		}
+		return 0;
+	}
+#endif
+
 	if (timeTest) {
 		/*
 		 * lists/1k.txt states: 964 / 1
@@ -172,25 +1502,47 @@ int main(int argc, char *argv[]) {
 	}
 
 	const FileWithPath &file = files[0];
-	Automata dict;
+	// a single file is watched and rebuilt in the background when it changes
+	std::unique_ptr<AutomataReloader> reloader;
+	std::shared_ptr<const Automata> fixedDict;
 	{
-		Automata::WordList words;
-		if (!readFileLines(file, words)) {
-			return 0;
-		}
-
-		std::cout << "Building ..." << std::endl;
-		dict.buildFromWordList(std::move(words));
+		const auto writeGraph = [](Automata &dict) {
+			dict.dumpGraph(dict.getDefaultGraphDump("viz.dot"));
+		};
 
-		std::cout << "Writing graph-viz ..." << std::endl;
-		dict.dumpGraph(dict.getDefaultGraphDump("viz.dot"));
+		std::cout << "Building and writing graph-viz ..." << std::endl;
+		if (files.size() == 1) {
+			reloader.reset(new AutomataReloader(file.path));
+			reloader->setPrepareCallback(writeGraph);
+			if (!reloader->load()) {
+				return 0;
+			}
+		} else {
+			Automata::WordList words;
+			if (!readFileLines(file, words)) {
+				return 0;
+			}
+			std::shared_ptr<Automata> built(new Automata);
+			built->buildFromWordList(std::move(words));
+			writeGraph(*built);
+			fixedDict = built;
+		}
+		const std::shared_ptr<const Automata> dict = reloader ? reloader->get() : fixedDict;
 
 		std::cout << "Running tests ..." << std::endl;
-		ac_assert(dict.runVerify());
+		ac_assert(dict->runVerify());
 
-		std::cout << "States in automata: " << dict.getNumberOfStates() << std::endl;
-		std::cout << "Words in automata: " << dict.getNumberOfWords() << std::endl;
-		std::cout << "Symbols in automata: " << dict.getNumberOfTotalSymbols() << std::endl;
+		std::cout << "States in automata: " << dict->getNumberOfStates() << std::endl;
+		std::cout << "Words in automata: " << dict->getNumberOfWords() << std::endl;
+		std::cout << "Symbols in automata: " << dict->getNumberOfTotalSymbols() << std::endl;
+	}
+
+	if (reloader) {
+		reloader->setSwapCallback([&file](const AutomataReloader::Stats &stats) {
+			std::cout << std::endl << "Reloaded " << file.path << ": " << stats.words << " words, read " << stats.readTime
+				<< "ms, build " << stats.buildTime << "ms, swap " << stats.swapTime << "ns" << std::endl;
+		});
+		reloader->start();
 	}
 
 	std::string input;
@@ -198,7 +1550,12 @@ int main(int argc, char *argv[]) {
 	std::cout << "Enter prefix: ";
 	while (std::cin >> input) {
 		Automata::WordList suffixes;
-		dict.getSuffixes(input, suffixes);
+		const auto start = timer::clock_t::now();
+		{
+			const std::shared_ptr<const Automata> dict = reloader ? reloader->get() : fixedDict;
+			dict->getSuffixes(input, suffixes);
+		}
+		const std::chrono::duration<double, std::micro> elapsed = timer::clock_t::now() - start;
 
 		if (suffixes.empty()) {
 			std::cout << "> no suffixes" << std::endl;
@@ -206,7 +1563,7 @@ int main(int argc, char *argv[]) {
 			for (const std::string &suffix : suffixes) {
 				std::cout << input << suffix << std::endl;
 			}
-			std::cout << "> " << suffixes.size() << " suffixes" << std::endl;
+			std::cout << "> " << suffixes.size() << " suffixes in " << elapsed.count() << "us" << std::endl;
 		}
 	}
 
@@ -0,0 +1,321 @@
+#include "SuccinctAutomata.h"
+
+namespace
+{
+
+/// Position of the set bit with a given index in a word
+/// @param n - index of the set bit, must be less than the number of set bits
+inline int selectInWord(uint64_t value, int n) {
+	for (int c = 0; c < n; c++) {
+		value &= value - 1;
+	}
+	return countTrailingZeros64(value);
+}
+
+/// Position of the highest set bit
+/// @param value - must not be 0
+inline int highestBit(uint64_t value) {
+	int index = 0;
+	while (value >>= 1) {
+		++index;
+	}
+	return index;
+}
+
+}
+
+constexpr SuccinctAutomata::StateId SuccinctAutomata::NO_STATE;
+
+void RankedBitVector::resize(size_t size) {
+	bits = size;
+	// one spare word so the last block is always complete
+	words.assign((size + 63) / 64 + 1, 0);
+	blockRanks.clear();
+	selectSamples.clear();
+}
+
+void RankedBitVector::buildIndex() {
+	const size_t blocks = (words.size() + BLOCK_WORDS - 1) / BLOCK_WORDS;
+	words.resize(blocks * BLOCK_WORDS, 0);
+	blockRanks.resize(blocks + 1);
+
+	size_t ones = 0;
+	for (size_t block = 0; block < blocks; block++) {
+		blockRanks[block] = uint32_t(ones);
+		for (int c = 0; c < BLOCK_WORDS; c++) {
+			ones += popCount64(words[block * BLOCK_WORDS + c]);
+		}
+	}
+	blockRanks[blocks] = uint32_t(ones);
+
+	// the spare bits after the end are zeros too but are never selected
+	const size_t zeros = bits - ones;
+	selectSamples.clear();
+	size_t block = 0;
+	for (size_t n = 0; n < zeros; n += SELECT_SAMPLE) {
+		while (block + 1 < blocks && blockZeros(block + 1) <= n) {
+			++block;
+		}
+		selectSamples.push_back(uint32_t(block));
+	}
+	selectSamples.push_back(uint32_t(blocks - 1));
+}
+
+size_t RankedBitVector::select0(size_t n) const {
+	// binary search between the blocks of the samples around n
+	size_t low = selectSamples[n / SELECT_SAMPLE];
+	size_t high = selectSamples[n / SELECT_SAMPLE + 1];
+	while (low < high) {
+		const size_t middle = (low + high + 1) / 2;
+		if (blockZeros(middle) <= n) {
+			low = middle;
+		} else {
+			high = middle - 1;
+		}
+	}
+
+	size_t remaining = n - blockZeros(low);
+	for (size_t c = low * BLOCK_WORDS; ; c++) {
+		const uint64_t zeros = ~words[c];
+		const size_t count = popCount64(zeros);
+		if (remaining < count) {
+			return c * 64 + selectInWord(zeros, int(remaining));
+		}
+		remaining -= count;
+	}
+}
+
+ptrdiff_t RankedBitVector::previousZero(size_t index) const {
+	ptrdiff_t word = ptrdiff_t(index >> 6);
+	const int offset = int(index & 63);
+	uint64_t zeros = offset ? ~words[word] & ((uint64_t(1) << offset) - 1) : 0;
+	while (!zeros) {
+		if (--word < 0) {
+			return -1;
+		}
+		zeros = ~words[word];
+	}
+	return word * 64 + highestBit(zeros);
+}
+
+size_t RankedBitVector::getMemoryUsage() const {
+	return words.capacity() * sizeof(uint64_t) + (blockRanks.capacity() + selectSamples.capacity()) * sizeof(uint32_t);
+}
+
+void PackedArray::resize(size_t count, int bitsPerValue) {
+	this->count = count;
+	this->bitsPerValue = bitsPerValue;
+	mask = bitsPerValue == 64 ? ~uint64_t(0) : (uint64_t(1) << bitsPerValue) - 1;
+	// one spare word so get can always read the word after the value
+	words.assign((count * bitsPerValue + 63) / 64 + 1, 0);
+}
+
+void PackedArray::set(size_t index, uint64_t value) {
+	const size_t bit = index * bitsPerValue;
+	const size_t word = bit >> 6;
+	const int offset = int(bit & 63);
+	value &= mask;
+	words[word] = (words[word] & ~(mask << offset)) | (value << offset);
+	if (offset + bitsPerValue > 64) {
+		const int shift = 64 - offset;
+		words[word + 1] = (words[word + 1] & ~(mask >> shift)) | (value >> shift);
+	}
+}
+
+int PackedArray::bitsFor(uint64_t maxValue) {
+	return maxValue ? highestBit(maxValue) + 1 : 1;
+}
+
+void SuccinctAutomata::Builder::start(uint32_t numVertices, uint32_t numEdges) {
+	finals.assign(numVertices, 0);
+	degrees.assign(numVertices, 0);
+	targets.clear();
+	targets.reserve(numEdges);
+	labels.clear();
+	labels.reserve(numEdges);
+}
+
+void SuccinctAutomata::Builder::addVertex(uint32_t id, bool isFinal) {
+	finals[id] = isFinal;
+}
+
+void SuccinctAutomata::Builder::addEdge(uint32_t from, uint32_t to, symbol label) {
+	++degrees[from];
+	targets.push_back(to);
+	labels.push_back(label);
+}
+
+void SuccinctAutomata::Builder::done() {
+	const size_t numStates = finals.size();
+	const size_t numEdges = targets.size();
+
+	automata.finals.resize(numStates);
+	automata.degrees.resize(numEdges + numStates);
+	std::vector<size_t> firstEdge(numStates + 1, 0);
+	size_t bit = 0;
+	for (size_t c = 0; c < numStates; c++) {
+		if (finals[c]) {
+			automata.finals.set(c);
+		}
+		firstEdge[c + 1] = firstEdge[c] + degrees[c];
+		for (uint32_t r = 0; r < degrees[c]; r++) {
+			automata.degrees.set(bit++);
+		}
+		// the zero bit ending the transitions of the state
+		++bit;
+	}
+	automata.degrees.buildIndex();
+
+	// dense codes only for the symbols that are used, in increasing order so that labels stay sorted
+	bool used[256] = {};
+	for (const symbol label : labels) {
+		used[static_cast<unsigned char>(label)] = true;
+	}
+	int numSymbols = 0;
+	for (int c = 0; c < 256; c++) {
+		automata.codes[c] = used[c] ? short(numSymbols) : short(-1);
+		if (used[c]) {
+			automata.symbols[numSymbols++] = symbol(c);
+		}
+	}
+	automata.labels.resize(numEdges, PackedArray::bitsFor(numSymbols ? numSymbols - 1 : 0));
+	automata.targets.resize(numEdges, PackedArray::bitsFor(numStates ? numStates - 1 : 0));
+	for (size_t c = 0; c < numEdges; c++) {
+		automata.labels.set(c, automata.codes[static_cast<unsigned char>(labels[c])]);
+		automata.targets.set(c, targets[c]);
+	}
+
+	// the words of a state are its own and the words of its children, children are counted first
+	std::vector<uint64_t> counts(numStates, 0);
+	std::vector<uint8_t> counted(numStates, 0);
+	std::vector<std::pair<StateId, size_t>> stack;
+	uint64_t maxCount = 0;
+	for (StateId root = 0; root < numStates; root++) {
+		if (counted[root]) {
+			continue;
+		}
+		stack.emplace_back(root, firstEdge[root]);
+		while (!stack.empty()) {
+			const StateId state = stack.back().first;
+			size_t &edge = stack.back().second;
+			if (edge < firstEdge[state + 1]) {
+				const StateId child = targets[edge++];
+				if (!counted[child]) {
+					stack.emplace_back(child, firstEdge[child]);
+				}
+				continue;
+			}
+			uint64_t count = finals[state];
+			for (size_t c = firstEdge[state]; c < firstEdge[state + 1]; c++) {
+				count += counts[targets[c]];
+			}
+			counts[state] = count;
+			counted[state] = 1;
+			maxCount = std::max(maxCount, count);
+			stack.pop_back();
+		}
+	}
+	automata.counts.resize(numStates, PackedArray::bitsFor(maxCount));
+	for (size_t c = 0; c < numStates; c++) {
+		automata.counts.set(c, counts[c]);
+	}
+
+	std::vector<uint8_t>().swap(finals);
+	std::vector<uint32_t>().swap(degrees);
+	std::vector<StateId>().swap(targets);
+	std::vector<symbol>().swap(labels);
+}
+
+void SuccinctAutomata::getEdges(StateId state, size_t &first, size_t &count) const {
+	const size_t end = degrees.select0(state);
+	const size_t start = size_t(degrees.previousZero(end) + 1);
+	first = start - state;
+	count = end - start;
+}
+
+SuccinctAutomata::StateId SuccinctAutomata::findState(const std::string &prefix) const {
+	if (finals.size() == 0) {
+		return NO_STATE;
+	}
+
+	StateId state = 0;
+	size_t first = 0, count = 0;
+	for (const symbol transition : prefix) {
+		const int code = codes[static_cast<unsigned char>(transition)];
+		if (code < 0) {
+			return NO_STATE;
+		}
+		getEdges(state, first, count);
+
+		// labels are sorted by code
+		size_t low = first, high = first + count;
+		while (low < high) {
+			const size_t middle = (low + high) / 2;
+			if (labels.get(middle) < uint64_t(code)) {
+				low = middle + 1;
+			} else {
+				high = middle;
+			}
+		}
+		if (low == first + count || labels.get(low) != uint64_t(code)) {
+			return NO_STATE;
+		}
+		state = StateId(targets.get(low));
+	}
+	return state;
+}
+
+bool SuccinctAutomata::getSuffixes(const std::string &prefix, WordList &suffixes, int limit) const {
+	const StateId start = findState(prefix);
+	if (start == NO_STATE) {
+		return false;
+	}
+
+	struct Frame {
+		size_t edge;
+		size_t end;
+	};
+	std::vector<Frame> stack;
+	std::string suffix;
+	size_t first = 0, count = 0;
+	int added = 0;
+
+	if (finals.get(start) && added < limit) {
+		suffixes.push_back(suffix);
+		++added;
+	}
+	getEdges(start, first, count);
+	stack.push_back(Frame{first, first + count});
+
+	while (!stack.empty() && added < limit) {
+		Frame &top = stack.back();
+		if (top.edge == top.end) {
+			stack.pop_back();
+			if (!suffix.empty()) {
+				suffix.pop_back();
+			}
+			continue;
+		}
+
+		const size_t edge = top.edge++;
+		const StateId state = StateId(targets.get(edge));
+		suffix.push_back(symbols[labels.get(edge)]);
+		if (finals.get(state)) {
+			suffixes.push_back(suffix);
+			++added;
+		}
+		getEdges(state, first, count);
+		stack.push_back(Frame{first, first + count});
+	}
+	return true;
+}
+
+uint64_t SuccinctAutomata::countWords(const std::string &prefix) const {
+	const StateId state = findState(prefix);
+	return state == NO_STATE ? 0 : counts.get(state);
+}
+
+size_t SuccinctAutomata::getMemoryUsage() const {
+	return degrees.getMemoryUsage() + finals.getMemoryUsage() +
+		labels.getMemoryUsage() + targets.getMemoryUsage() + counts.getMemoryUsage();
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include "Automata.h"
+
+/// Bit vector with select of the zero bits through the sampled rank of blocks and sampled positions of zeros
+struct RankedBitVector {
+	/// Set the number of bits, all bits are cleared
+	void resize(size_t size);
+
+	void set(size_t index) {
+		words[index >> 6] |= uint64_t(1) << (index & 63);
+	}
+
+	bool get(size_t index) const {
+		return (words[index >> 6] >> (index & 63)) & 1;
+	}
+
+	size_t size() const {
+		return bits;
+	}
+
+	/// Build the rank and select samples, must be called after the last set and before select0
+	void buildIndex();
+
+	/// Position of the zero bit with a given index
+	/// @param n - index of the zero bit, 0 for the first one, must be less than the number of zero bits
+	size_t select0(size_t n) const;
+
+	/// Position of the last zero bit before some position
+	/// @return the position or -1 if there are only set bits before @index
+	ptrdiff_t previousZero(size_t index) const;
+
+	/// Bytes used by the bits and the samples
+	size_t getMemoryUsage() const;
+
+private:
+	/// The bits in blocks of BLOCK_WORDS words have their rank sampled
+	static const int BLOCK_WORDS = 8;
+	/// Every SELECT_SAMPLE-th zero bit has the index of its block sampled
+	static const int SELECT_SAMPLE = 512;
+
+	std::vector<uint64_t> words;
+	/// Number of set bits before each block
+	std::vector<uint32_t> blockRanks;
+	/// The block of each SELECT_SAMPLE-th zero bit
+	std::vector<uint32_t> selectSamples;
+	size_t bits = 0;
+
+	/// Number of zero bits before a block
+	size_t blockZeros(size_t block) const {
+		return block * BLOCK_WORDS * 64 - blockRanks[block];
+	}
+};
+
+/// Array of unsigned integers, each one stored with the same number of bits
+struct PackedArray {
+	/// Set the number of values and bits for each of them, all values are 0
+	void resize(size_t count, int bitsPerValue);
+
+	void set(size_t index, uint64_t value);
+
+	uint64_t get(size_t index) const {
+		const size_t bit = index * bitsPerValue;
+		const size_t word = bit >> 6;
+		const int offset = int(bit & 63);
+		uint64_t value = words[word] >> offset;
+		if (offset + bitsPerValue > 64) {
+			value |= words[word + 1] << (64 - offset);
+		}
+		return value & mask;
+	}
+
+	size_t size() const {
+		return count;
+	}
+
+	size_t getMemoryUsage() const {
+		return words.capacity() * sizeof(uint64_t);
+	}
+
+	/// The number of bits needed to store values up to some maximum, at least 1
+	static int bitsFor(uint64_t maxValue);
+
+private:
+	std::vector<uint64_t> words;
+	size_t count = 0;
+	int bitsPerValue = 1;
+	uint64_t mask = 1;
+};
+
+/// Read only copy of a frozen automata in a few bits per state and transition, for dictionaries too big to keep frozen
+/// All states are in the same order as in the automata:
+///   degrees - for each state one set bit for each transition followed by a zero bit, so the transitions of a state
+///             start at select0(state - 1) + 1 - state
+///   labels - the label of each transition, packed to the bits needed for the symbols that are used
+///   targets - the target state of each transition, packed to the bits needed for the number of states
+///   counts - the number of words starting at each state, packed to the bits needed for the biggest one
+/// Does not keep the word list, words are rebuilt from the labels when enumerating
+struct SuccinctAutomata {
+	typedef BasicAutomata<ByteAlphabet>::WordList WordList;
+	typedef uint32_t StateId;
+	static constexpr StateId NO_STATE = StateId(-1);
+
+	/// Build from a frozen automata
+	/// @return false if the automata could not be dumped
+	template <typename Alphabet>
+	bool build(const BasicAutomata<Alphabet> &automata) {
+		Builder builder(*this);
+		return automata.dumpGraph(&builder);
+	}
+
+	/// Check if some word starts with the prefix
+	bool hasPrefix(const std::string &prefix) const {
+		return findState(prefix) != NO_STATE;
+	}
+
+	/// Get up to some number of suffixes for a given prefix in lexicographic order
+	/// @param prefix - the prefix to search for
+	/// @param suffixes[out] - the suffixes are appended here, the empty suffix first if prefix is a word
+	/// @param limit - the maximum number of suffixes to append
+	/// @return false if the prefix is not recognized, true otherwise
+	bool getSuffixes(const std::string &prefix, WordList &suffixes, int limit) const;
+
+	/// Get the number of words starting with a prefix, without enumerating them
+	/// @return the number of words or 0 if the prefix is not recognized
+	uint64_t countWords(const std::string &prefix) const;
+
+	/// Number of words recognized by the automata
+	uint64_t getNumberOfWords() const {
+		return counts.size() ? counts.get(0) : 0;
+	}
+
+	int getNumberOfStates() const {
+		return int(finals.size());
+	}
+
+	int getNumberOfEdges() const {
+		return int(targets.size());
+	}
+
+	/// Bytes used by all bit vectors and packed arrays
+	size_t getMemoryUsage() const;
+
+private:
+	/// Collects the states and transitions of an automata through GraphDump and packs them when done
+	struct Builder : GraphDump {
+		SuccinctAutomata &automata;
+		std::vector<uint8_t> finals;
+		std::vector<uint32_t> degrees;
+		std::vector<StateId> targets;
+		std::vector<symbol> labels;
+
+		explicit Builder(SuccinctAutomata &automata)
+			: automata(automata)
+		{}
+
+		void start(uint32_t numVertices, uint32_t numEdges) override;
+		void addVertex(uint32_t id, bool isFinal) override;
+		void addEdge(uint32_t from, uint32_t to, symbol label) override;
+		void done() override;
+	};
+
+	RankedBitVector degrees;
+	RankedBitVector finals;
+	PackedArray labels;
+	PackedArray targets;
+	PackedArray counts;
+	/// The code of each symbol in labels, -1 for symbols that are not used, codes are in unsigned byte order
+	short codes[256];
+	/// The symbol for each code
+	symbol symbols[256];
+
+	/// Get the transitions of a state
+	/// @param first[out] - the index of the first transition in labels and targets
+	/// @param count[out] - the number of transitions
+	void getEdges(StateId state, size_t &first, size_t &count) const;
+
+	/// Find the state for a prefix
+	/// @return the state or NO_STATE if the prefix is not recognized
+	StateId findState(const std::string &prefix) const;
+};